@@ -0,0 +1,495 @@
+#include "batch_io.h"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+using namespace std;
+
+//в glibc нет обёрток для io_uring, вызовы делаются напрямую
+static int uringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int uringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int uringRegister(int ringFd, unsigned opcode, const void* arg, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, ringFd, opcode, arg, count));
+}
+
+//кольца отправки и завершения одного экземпляра io_uring
+class UringQueue {
+public:
+    UringQueue() : ringFd(-1), sqMemory(MAP_FAILED), cqMemory(MAP_FAILED), sqeMemory(MAP_FAILED),
+                   sqMemorySize(0), cqMemorySize(0), sqeMemorySize(0), sqEntries(0), localTail(0),
+                   pending(0), fixedBuffers(false) {}
+    
+    UringQueue(const UringQueue&) = delete;
+    UringQueue& operator=(const UringQueue&) = delete;
+    
+    ~UringQueue() {
+        shutdown();
+    }
+    
+    //закрытие кольца: ядро отменяет незавершённые операции и перестаёт
+    //ссылаться на буферы ячеек
+    void shutdown() {
+        if (sqeMemory != MAP_FAILED) munmap(sqeMemory, sqeMemorySize);
+        if (cqMemory != MAP_FAILED && cqMemory != sqMemory) munmap(cqMemory, cqMemorySize);
+        if (sqMemory != MAP_FAILED) munmap(sqMemory, sqMemorySize);
+        if (ringFd >= 0) close(ringFd);
+        sqeMemory = cqMemory = sqMemory = MAP_FAILED;
+        ringFd = -1;
+    }
+    
+    //создание колец на entries операций и регистрация буферов; false - io_uring
+    //недоступен или не знает нужных операций
+    bool open(unsigned entries, const vector<iovec>& buffers) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ringFd = uringSetup(entries, &params);
+        if (ringFd < 0) return false;
+        
+        sqEntries = params.sq_entries;
+        sqMemorySize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqMemorySize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMapping) sqMemorySize = cqMemorySize = max(sqMemorySize, cqMemorySize);
+        
+        sqMemory = mmap(nullptr, sqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqMemory == MAP_FAILED) return false;
+        if (singleMapping) {
+            cqMemory = sqMemory;
+        } else {
+            cqMemory = mmap(nullptr, cqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+            if (cqMemory == MAP_FAILED) return false;
+        }
+        sqeMemorySize = params.sq_entries * sizeof(io_uring_sqe);
+        sqeMemory = mmap(nullptr, sqeMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqeMemory == MAP_FAILED) return false;
+        
+        char* sq = static_cast<char*>(sqMemory);
+        char* cq = static_cast<char*>(cqMemory);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        sqes = static_cast<io_uring_sqe*>(sqeMemory);
+        localTail = *sqTail;
+        
+        if (!supportsOperations()) return false;
+        
+        //закреплённые буферы экономят ядру отображение страниц на каждой
+        //операции; если лимит закреплённой памяти мал, работаем с обычными
+        fixedBuffers = uringRegister(ringFd, IORING_REGISTER_BUFFERS, buffers.data(),
+                                     static_cast<unsigned>(buffers.size())) == 0;
+        if (!fixedBuffers) {
+            return opSupported[IORING_OP_READ] && opSupported[IORING_OP_WRITE];
+        }
+        return true;
+    }
+    
+    bool usesFixedBuffers() const { return fixedBuffers; }
+    
+    //следующая свободная запись очереди отправки, обнулённая
+    io_uring_sqe* nextSqe() {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (localTail - head >= sqEntries) {
+            throw runtime_error("Очередь io_uring переполнена");
+        }
+        unsigned index = localTail & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        localTail++;
+        pending++;
+        return sqe;
+    }
+    
+    //отправка подготовленных операций одним системным вызовом
+    //и ожидание хотя бы waitCount завершений. false - ядру временно не
+    //хватает ресурсов (EAGAIN, EBUSY): операции остаются в очереди и
+    //отправляются снова, когда завершится что-то из уже отправленного
+    bool submit(unsigned waitCount) {
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        int submitted;
+        do {
+            submitted = uringEnter(ringFd, pending, waitCount, waitCount ? IORING_ENTER_GETEVENTS : 0);
+        } while (submitted < 0 && errno == EINTR);
+        if (submitted < 0) {
+            if (errno == EAGAIN || errno == EBUSY) return false;
+            throw runtime_error(string("Ошибка io_uring: ") + strerror(errno));
+        }
+        pending -= min(pending, static_cast<unsigned>(submitted));
+        return true;
+    }
+    
+    //ожидание хотя бы одного завершения без отправки новых операций
+    void waitCompletion() {
+        int result;
+        do {
+            result = uringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+        } while (result < 0 && errno == EINTR);
+        if (result < 0) {
+            throw runtime_error(string("Ошибка io_uring: ") + strerror(errno));
+        }
+    }
+    
+    //операции, подготовленные, но ещё не принятые ядром
+    vector<const io_uring_sqe*> unsubmitted() const {
+        vector<const io_uring_sqe*> result;
+        for (unsigned i = localTail - pending; i != localTail; i++) {
+            result.push_back(&sqes[sqArray[i & sqMask]]);
+        }
+        return result;
+    }
+    
+    //забирает одно завершение; false - завершений нет
+    bool popCompletion(io_uring_cqe& cqe) {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+        cqe = cqes[head & cqMask];
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    //ядра до 5.6 не умеют открывать и закрывать файлы через io_uring
+    bool supportsOperations() {
+        const unsigned probeOps = 256;
+        vector<char> memory(sizeof(io_uring_probe) + probeOps * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(memory.data());
+        if (uringRegister(ringFd, IORING_REGISTER_PROBE, probe, probeOps) < 0) return false;
+        
+        for (unsigned op = 0; op < IORING_OP_LAST; op++) {
+            opSupported[op] = op <= probe->last_op && op < probe->ops_len &&
+                              (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        }
+        return opSupported[IORING_OP_OPENAT] && opSupported[IORING_OP_CLOSE] &&
+               opSupported[IORING_OP_READ_FIXED] && opSupported[IORING_OP_WRITE_FIXED];
+    }
+    
+    int ringFd;
+    void* sqMemory;
+    void* cqMemory;
+    void* sqeMemory;
+    size_t sqMemorySize;
+    size_t cqMemorySize;
+    size_t sqeMemorySize;
+    
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned* sqArray;
+    io_uring_sqe* sqes;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    io_uring_cqe* cqes;
+    
+    unsigned sqEntries;
+    unsigned localTail;         //хвост очереди отправки до публикации ядру
+    unsigned pending;           //подготовлено, но ещё не отправлено
+    bool fixedBuffers;
+    bool opSupported[IORING_OP_LAST];
+};
+
+//пакет файлов на одном кольце. Каждая ячейка ведёт один файл через этапы
+//OPEN_INPUT -> READ -> CLOSE_INPUT -> (преобразование) -> OPEN_OUTPUT -> WRITE -> CLOSE_OUTPUT,
+//у ячейки в ядре не больше одной операции, поэтому очереди хватает по записи на ячейку
+class UringBatch {
+public:
+    UringBatch(vector<BatchJob>& jobs, const BatchOptions& options, const BatchTransform& transform)
+        : jobs(jobs), options(options), transform(transform), nextJob(0), active(0) {
+        //вход ячейки на байт больше bufferSize: так без лишнего stat видно,
+        //что файл не поместился
+        inputCapacity = options.bufferSize + 1;
+        slotSize = inputCapacity + (options.inPlace ? 0 : options.bufferSize);
+        unsigned slotCount = static_cast<unsigned>(min<size_t>(max(options.queueDepth, 1u), jobs.size()));
+        memory.resize(slotCount * slotSize);
+        slots.resize(slotCount);
+        for (unsigned i = 0; i < slotCount; i++) {
+            slots[i].buffer = memory.data() + i * slotSize;
+            buffers.push_back({slots[i].buffer, slotSize});
+        }
+    }
+    
+    bool run() {
+        if (!queue.open(static_cast<unsigned>(slots.size()), buffers)) return false;
+        
+        try {
+            for (size_t slot = 0; slot < slots.size(); slot++) {
+                startNextJob(slot);
+            }
+            while (active > 0) {
+                if (!queue.submit(1)) {
+                    //ядро примет новые операции, когда завершатся отправленные;
+                    //если отправленных нет, ждать нечего
+                    if (queue.unsubmitted().size() >= active) {
+                        throw runtime_error("Ошибка io_uring: ядро не принимает операции");
+                    }
+                    queue.waitCompletion();
+                }
+                io_uring_cqe cqe;
+                while (queue.popCompletion(cqe)) {
+                    slots[cqe.user_data].busy = false;
+                    advance(static_cast<size_t>(cqe.user_data), cqe.res);
+                }
+            }
+        } catch (const exception&) {
+            abandon();
+        }
+        return true;
+    }
+
+private:
+    enum Stage { OPEN_INPUT, READ, CLOSE_INPUT, OPEN_OUTPUT, WRITE, CLOSE_OUTPUT };
+    
+    struct Slot {
+        size_t job;
+        Stage stage;
+        int fd;
+        uint8_t* buffer;
+        size_t length;          //прочитано байт
+        uint8_t* result;
+        size_t resultLength;
+        size_t written;
+        bool inUse;             //в ячейке файл в обработке
+        bool busy;              //операция ячейки в очереди или в ядре
+        
+        Slot() : job(0), stage(OPEN_INPUT), fd(-1), buffer(nullptr), length(0),
+                 result(nullptr), resultLength(0), written(0), inUse(false), busy(false) {}
+    };
+    
+    //кольцо перестало работать: файлы, которые не успели обработать,
+    //оставляются для обычной обработки. Сначала дожидаемся операций, уже
+    //принятых ядром, - они пишут в буферы ячеек и могут открыть файлы
+    void abandon() {
+        for (const io_uring_sqe* sqe : queue.unsubmitted()) {
+            slots[sqe->user_data].busy = false;
+            //закрытие так и не отправлено: дескриптор закрываем сами
+            if (sqe->opcode == IORING_OP_CLOSE) close(sqe->fd);
+        }
+        
+        bool drained = true;
+        try {
+            while (any_of(slots.begin(), slots.end(), [](const Slot& slot) { return slot.busy; })) {
+                queue.waitCompletion();
+                io_uring_cqe cqe;
+                while (queue.popCompletion(cqe)) {
+                    Slot& slot = slots[cqe.user_data];
+                    slot.busy = false;
+                    if (slot.stage == OPEN_INPUT || slot.stage == OPEN_OUTPUT) {
+                        if (cqe.res >= 0) slot.fd = cqe.res;
+                    } else if (slot.stage == CLOSE_INPUT || slot.stage == CLOSE_OUTPUT) {
+                        slot.fd = -1;
+                    }
+                }
+            }
+        } catch (const exception&) {
+            drained = false;
+        }
+        //дождаться операций не удалось: кольцо закрывается сразу, память
+        //буферов освобождается уже после него, вместе с пакетом
+        if (!drained) queue.shutdown();
+        
+        for (Slot& slot : slots) {
+            if (slot.fd >= 0) close(slot.fd);
+            if (slot.inUse) {
+                jobs[slot.job].error.clear();
+                jobs[slot.job].deferred = true;
+                slot.inUse = false;
+            }
+        }
+        for (; nextJob < jobs.size(); nextJob++) {
+            jobs[nextJob].deferred = true;
+        }
+        active = 0;
+    }
+    
+    void startNextJob(size_t index) {
+        if (nextJob == jobs.size()) return;
+        Slot& slot = slots[index];
+        slot = Slot();
+        slot.job = nextJob++;
+        slot.buffer = static_cast<uint8_t*>(buffers[index].iov_base);
+        slot.inUse = true;
+        active++;
+        
+        queueOpen(index, jobs[slot.job].input, O_RDONLY | O_CLOEXEC, OPEN_INPUT);
+    }
+    
+    void finishJob(size_t index) {
+        slots[index].inUse = false;
+        active--;
+        startNextJob(index);
+    }
+    
+    void queueOpen(size_t index, const string& path, int flags, Stage stage) {
+        slots[index].stage = stage;
+        io_uring_sqe* sqe = queue.nextSqe();
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(path.c_str());
+        sqe->len = 0644;
+        sqe->open_flags = flags;
+        sqe->user_data = index;
+        slots[index].busy = true;
+    }
+    
+    void queueClose(size_t index, Stage stage) {
+        Slot& slot = slots[index];
+        slot.stage = stage;
+        io_uring_sqe* sqe = queue.nextSqe();
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = slot.fd;
+        sqe->user_data = index;
+        slot.fd = -1;
+        slot.busy = true;
+    }
+    
+    void queueTransfer(size_t index, Stage stage, uint8_t* data, size_t length, uint64_t offset) {
+        Slot& slot = slots[index];
+        slot.stage = stage;
+        bool fixed = queue.usesFixedBuffers();
+        io_uring_sqe* sqe = queue.nextSqe();
+        if (stage == READ) {
+            sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        } else {
+            sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        }
+        sqe->fd = slot.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = static_cast<uint32_t>(min<size_t>(length, 1u << 30));
+        sqe->off = offset;
+        if (fixed) sqe->buf_index = static_cast<uint16_t>(index);
+        sqe->user_data = index;
+        slot.busy = true;
+    }
+    
+    //ошибка файла: дескриптор, если он открыт, закрывается, затем ячейка свободна
+    void failJob(size_t index, const string& message) {
+        Slot& slot = slots[index];
+        if (jobs[slot.job].error.empty()) jobs[slot.job].error = message;
+        if (slot.fd >= 0) {
+            queueClose(index, slot.stage == OPEN_OUTPUT || slot.stage == WRITE ? CLOSE_OUTPUT : CLOSE_INPUT);
+        } else {
+            finishJob(index);
+        }
+    }
+    
+    void advance(size_t index, int res) {
+        Slot& slot = slots[index];
+        BatchJob& job = jobs[slot.job];
+        
+        switch (slot.stage) {
+            case OPEN_INPUT:
+                if (res < 0) return failJob(index, "Не удалось открыть файл " + job.input);
+                slot.fd = res;
+                queueTransfer(index, READ, slot.buffer, inputCapacity, 0);
+                return;
+            
+            case READ:
+                if (res < 0) return failJob(index, string("Ошибка чтения: ") + strerror(-res));
+                slot.length += res;
+                //читаем до конца файла или пока не станет ясно, что он не помещается
+                if (res > 0 && slot.length < inputCapacity) {
+                    queueTransfer(index, READ, slot.buffer + slot.length, inputCapacity - slot.length, slot.length);
+                    return;
+                }
+                if (slot.length > options.bufferSize) job.deferred = true;
+                queueClose(index, CLOSE_INPUT);
+                return;
+            
+            case CLOSE_INPUT:
+                if (!job.error.empty() || job.deferred) return finishJob(index);
+                transformSlot(index);
+                return;
+            
+            case OPEN_OUTPUT:
+                if (res < 0) return failJob(index, "Не удалось создать файл " + job.output);
+                slot.fd = res;
+                if (slot.resultLength == 0) {
+                    queueClose(index, CLOSE_OUTPUT);
+                } else {
+                    queueTransfer(index, WRITE, slot.result, slot.resultLength, 0);
+                }
+                return;
+            
+            case WRITE:
+                if (res < 0) return failJob(index, string("Ошибка записи: ") + strerror(-res));
+                if (res == 0) return failJob(index, "Ошибка записи в файл " + job.output);
+                slot.written += res;
+                if (slot.written < slot.resultLength) {
+                    queueTransfer(index, WRITE, slot.result + slot.written, slot.resultLength - slot.written, slot.written);
+                } else {
+                    queueClose(index, CLOSE_OUTPUT);
+                }
+                return;
+            
+            case CLOSE_OUTPUT:
+                if (res < 0 && job.error.empty()) job.error = "Ошибка записи в файл " + job.output;
+                finishJob(index);
+                return;
+        }
+    }
+    
+    //преобразование прочитанного файла в потоке кольца, пока остальные
+    //файлы пакета читаются и пишутся ядром
+    void transformSlot(size_t index) {
+        Slot& slot = slots[index];
+        BatchJob& job = jobs[slot.job];
+        uint8_t* out = options.inPlace ? slot.buffer : slot.buffer + inputCapacity;
+        size_t capacity = options.inPlace ? inputCapacity : options.bufferSize;
+        
+        try {
+            slot.resultLength = transform(slot.buffer, slot.length, out, capacity);
+        } catch (const exception& e) {
+            job.error = e.what();
+            return finishJob(index);
+        }
+        if (slot.resultLength == BATCH_DEFER) {
+            job.deferred = true;
+            return finishJob(index);
+        }
+        
+        slot.result = out;
+        queueOpen(index, job.output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, OPEN_OUTPUT);
+    }
+    
+    vector<BatchJob>& jobs;
+    const BatchOptions& options;
+    const BatchTransform& transform;
+    
+    size_t inputCapacity;
+    size_t slotSize;
+    vector<uint8_t> memory;
+    vector<iovec> buffers;
+    UringQueue queue;           //после буферов: кольцо закрывается раньше, чем освобождается память
+    vector<Slot> slots;
+    size_t nextJob;
+    size_t active;              //ячеек с файлом в обработке
+};
+
+bool runUringBatch(vector<BatchJob>& jobs, const BatchOptions& options, const BatchTransform& transform) {
+    if (options.bufferSize == 0) {
+        throw invalid_argument("Размер буфера пакета должен быть больше нуля");
+    }
+    if (jobs.empty()) return true;
+    
+    UringBatch batch(jobs, options, transform);
+    return batch.run();
+}
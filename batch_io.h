@@ -0,0 +1,52 @@
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//файл пакетной обработки
+struct BatchJob {
+    string input;
+    string output;
+    string error;           //пусто - файл обработан успешно
+    bool deferred;          //файл не поместился в буфер пакета или кольцо
+                            //отказало до его обработки; оставлен для
+                            //обычной обработки
+    
+    BatchJob() : deferred(false) {}
+};
+
+//результат преобразования, при котором файл откладывается для обычной обработки
+const size_t BATCH_DEFER = SIZE_MAX;
+
+//преобразование содержимого файла: data длиной length, результат пишется
+//в out ёмкостью outCapacity (out может совпадать с data). Возвращает длину
+//результата или BATCH_DEFER; исключение означает ошибку только этого файла
+typedef function<size_t(uint8_t* data, size_t length, uint8_t* out, size_t outCapacity)> BatchTransform;
+
+//параметры пакетной обработки
+struct BatchOptions {
+    size_t bufferSize;      //наибольший размер файла, обрабатываемого в пакете
+    unsigned queueDepth;    //число файлов в обработке одновременно
+    bool inPlace;           //результат пишется поверх входа, второй буфер не нужен
+    
+    BatchOptions() : bufferSize(256 * 1024), queueDepth(32), inPlace(false) {}
+};
+
+//пакетная обработка множества небольших файлов через io_uring: открытие,
+//чтение, запись и закрытие всех файлов очереди отправляются в ядро общими
+//пакетами, чтение и запись идут в заранее зарегистрированные буферы, а
+//прочитанный файл сразу передаётся в преобразование. Ошибки отдельных файлов
+//записываются в BatchJob::error, файлы больше bufferSize помечаются deferred.
+//Если кольцо перестаёт работать посреди пакета, все ещё не обработанные
+//файлы тоже помечаются deferred.
+//Возвращает false, если io_uring недоступен (ядро без поддержки или запрет
+//в настройках) - тогда ни один файл не тронут
+bool runUringBatch(vector<BatchJob>& jobs, const BatchOptions& options, const BatchTransform& transform);
+
+#endif
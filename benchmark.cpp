@@ -0,0 +1,518 @@
+//замеры производительности экспортируемых функций шифров.
+//Библиотеки загружаются так же, как в основной программе, поэтому
+//измеряется именно тот код, который работает в ней.
+//Сборка: g++ -std=c++17 -O2 benchmark.cpp -ldl -o cipher_benchmark
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <atomic>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <new>
+#include <dlfcn.h>
+#include <getopt.h>
+
+#include "cipher_plugin.h"
+
+using namespace std;
+
+//счётчики выделений памяти: operator new программы замещает его и в библиотеках.
+//operator delete не встраивается, иначе компилятор видит пару new/free
+static atomic<size_t> allocationCount(0);
+static atomic<size_t> allocationBytes(0);
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocationBytes.fetch_add(size, memory_order_relaxed);
+    void* pointer = malloc(size ? size : 1);
+    if (!pointer) throw bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+__attribute__((noinline)) void operator delete[](void* pointer) noexcept {
+    free(pointer);
+}
+
+__attribute__((noinline)) void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+__attribute__((noinline)) void operator delete[](void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+//типы наборов данных
+enum class ContentMix {
+    ASCII = 0,
+    CYRILLIC = 1,
+    MIXED = 2,
+    BINARY = 3
+};
+
+const char* CONTENT_NAMES[] = {"ascii", "cyrillic", "mixed", "binary"};
+
+//функции одной библиотеки
+struct BenchmarkCipher {
+    const char* name;
+    const char* libraryName;
+    const char* encryptTextName;
+    const char* decryptTextName;
+    const char* encryptBinaryName;
+    const char* decryptBinaryName;
+    const char* descriptorName;
+    bool digitKey;      //ключ из цифр (Гронсфельд)
+    bool textFlag;      //у текстовых функций есть параметр useCyrillic
+    void* handle;
+    void* encryptText;
+    void* decryptText;
+    string (*encryptBinary)(const string&, const string&);
+    string (*decryptBinary)(const string&, const string&);
+    const CipherPluginDescriptor* descriptor;
+};
+
+//результат одного замера
+struct BenchmarkResult {
+    string cipher;
+    string function;
+    string content;
+    size_t size;
+    size_t keyLength;
+    size_t iterations;
+    double nsPerCall;
+    double nsPerByte;
+    double mbPerSecond;
+    double allocationsPerCall;
+    double allocatedBytesPerCall;
+};
+
+//параметры запуска
+struct BenchmarkOptions {
+    vector<size_t> sizes;
+    vector<size_t> keyLengths;
+    vector<ContentMix> contents;
+    string cipherFilter;
+    string functionFilter;
+    double minSeconds;
+    string jsonFile;
+    
+    BenchmarkOptions() : minSeconds(0.2) {}
+};
+
+//результат функций сохраняется сюда, чтобы вызовы не были выброшены оптимизатором
+static volatile size_t benchmarkSink = 0;
+
+//загрузка библиотеки шифра
+bool loadBenchmarkCipher(BenchmarkCipher& cipher) {
+    cipher.handle = dlopen(cipher.libraryName, RTLD_NOW);
+    if (!cipher.handle) {
+        cerr << "Ошибка загрузки библиотеки " << cipher.libraryName << ": " << dlerror() << endl;
+        return false;
+    }
+    
+    cipher.encryptText = dlsym(cipher.handle, cipher.encryptTextName);
+    cipher.decryptText = dlsym(cipher.handle, cipher.decryptTextName);
+    cipher.encryptBinary = reinterpret_cast<string(*)(const string&, const string&)>(dlsym(cipher.handle, cipher.encryptBinaryName));
+    cipher.decryptBinary = reinterpret_cast<string(*)(const string&, const string&)>(dlsym(cipher.handle, cipher.decryptBinaryName));
+    CipherPluginEntry entry = reinterpret_cast<CipherPluginEntry>(dlsym(cipher.handle, cipher.descriptorName));
+    cipher.descriptor = entry ? entry() : nullptr;
+    
+    if (!cipher.encryptText || !cipher.decryptText || !cipher.encryptBinary || !cipher.decryptBinary) {
+        cerr << "Ошибка загрузки функций из библиотеки " << cipher.libraryName << endl;
+        dlclose(cipher.handle);
+        cipher.handle = nullptr;
+        return false;
+    }
+    
+    //описание принимаем только от библиотеки с совместимой версией интерфейса,
+    //как и основная программа
+    if (cipher.descriptor && (cipher.descriptor->abiVersion != CIPHER_PLUGIN_ABI_VERSION ||
+                              cipher.descriptor->structSize < CIPHER_PLUGIN_BASE_SIZE)) {
+        cipher.descriptor = nullptr;
+    }
+    
+    //бинарные функции по умолчанию однопоточные, замеряем их так же, как текстовые
+    if (cipher.descriptor) {
+        cipher.descriptor->setParallelism(1, 0);
+    }
+    return true;
+}
+
+//вызов текстовой функции с учётом её сигнатуры
+string callText(const BenchmarkCipher& cipher, void* function, const string& text, const string& key) {
+    if (cipher.textFlag) {
+        return reinterpret_cast<string(*)(const string&, const string&, bool)>(function)(text, key, true);
+    }
+    return reinterpret_cast<string(*)(const string&, const string&)>(function)(text, key);
+}
+
+//набор данных заданного размера
+string makeContent(ContentMix mix, size_t size, mt19937_64& random) {
+    static const char ASCII_TEXT[] = "The quick brown fox jumps over the lazy dog, 0123456789. ";
+    static const char CYRILLIC_TEXT[] = "Съешь же ещё этих мягких французских булок да выпей чаю ";
+    
+    string content;
+    content.reserve(size);
+    if (mix == ContentMix::BINARY) {
+        while (content.size() < size) {
+            content += static_cast<char>(random() & 0xFF);
+        }
+        return content;
+    }
+    
+    const char* phrases[] = {ASCII_TEXT, CYRILLIC_TEXT};
+    size_t phrase = mix == ContentMix::CYRILLIC ? 1 : 0;
+    while (content.size() < size) {
+        content += phrases[phrase];
+        if (mix == ContentMix::MIXED) phrase ^= 1;
+    }
+    
+    //не разрываем кириллическую пару на границе
+    content.resize(size);
+    if (!content.empty() && (content.back() == '\xD0' || content.back() == '\xD1')) {
+        content.back() = ' ';
+    }
+    return content;
+}
+
+//ключ заданной длины в байтах
+string makeKey(const BenchmarkCipher& cipher, size_t length, mt19937_64& random) {
+    string key;
+    for (size_t i = 0; i < length; i++) {
+        if (cipher.digitKey) {
+            key += static_cast<char>('0' + random() % 10);
+        } else {
+            key += static_cast<char>('a' + random() % 26);
+        }
+    }
+    return key;
+}
+
+//замер одной функции: вызовы повторяются, пока не наберётся minSeconds
+BenchmarkResult measure(const string& cipher, const string& functionName, ContentMix mix, const string& input,
+                        size_t keyLength, double minSeconds, const function<string(const string&)>& call) {
+    //прогрев: первые вызовы загружают страницы и кэш
+    benchmarkSink = benchmarkSink + call(input).size();
+    
+    size_t iterations = 0;
+    size_t allocationsBefore = allocationCount.load();
+    size_t bytesBefore = allocationBytes.load();
+    auto start = chrono::steady_clock::now();
+    double elapsed = 0;
+    do {
+        benchmarkSink = benchmarkSink + call(input).size();
+        iterations++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < minSeconds);
+    
+    BenchmarkResult result;
+    result.cipher = cipher;
+    result.function = functionName;
+    result.content = CONTENT_NAMES[static_cast<int>(mix)];
+    result.size = input.size();
+    result.keyLength = keyLength;
+    result.iterations = iterations;
+    result.nsPerCall = elapsed * 1e9 / iterations;
+    result.nsPerByte = input.empty() ? 0 : result.nsPerCall / input.size();
+    result.mbPerSecond = input.size() / (result.nsPerCall / 1e9) / (1024.0 * 1024.0);
+    result.allocationsPerCall = static_cast<double>(allocationCount.load() - allocationsBefore) / iterations;
+    result.allocatedBytesPerCall = static_cast<double>(allocationBytes.load() - bytesBefore) / iterations;
+    return result;
+}
+
+//экранирование строки для JSON
+string jsonString(const string& value) {
+    string result = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') result += '\\';
+        result += c;
+    }
+    return result + "\"";
+}
+
+//название уровня векторизации
+const char* simdName(const BenchmarkCipher& cipher) {
+    if (!cipher.descriptor) return "unknown";
+    switch (cipher.descriptor->simdLevel) {
+        case CIPHER_SIMD_AVX2:
+            return "avx2";
+        case CIPHER_SIMD_SSE2:
+            return "sse2";
+        default:
+            return "none";
+    }
+}
+
+//отчёт в формате JSON: по одному объекту на замер, порядок полей постоянный,
+//чтобы отчёты разных сборок можно было сравнивать построчно
+void writeJson(ostream& out, const vector<BenchmarkCipher>& ciphers, const vector<BenchmarkResult>& results) {
+    out << "{\n  \"ciphers\": [\n";
+    for (size_t i = 0; i < ciphers.size(); i++) {
+        out << "    {\"name\": " << jsonString(ciphers[i].name) << ", \"simd\": " << jsonString(simdName(ciphers[i]))
+            << "}" << (i + 1 < ciphers.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& r = results[i];
+        out << "    {\"cipher\": " << jsonString(r.cipher)
+            << ", \"function\": " << jsonString(r.function)
+            << ", \"content\": " << jsonString(r.content)
+            << ", \"size\": " << r.size
+            << ", \"key_length\": " << r.keyLength
+            << ", \"iterations\": " << r.iterations
+            << ", \"ns_per_call\": " << r.nsPerCall
+            << ", \"ns_per_byte\": " << r.nsPerByte
+            << ", \"mb_per_s\": " << r.mbPerSecond
+            << ", \"allocs_per_call\": " << r.allocationsPerCall
+            << ", \"alloc_bytes_per_call\": " << r.allocatedBytesPerCall
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+//разбор размера с суффиксом K, M или G; false - строка не размер целиком
+//или размер не помещается в size_t
+bool parseSize(const string& text, size_t& value) {
+    if (text.empty() || text[0] < '0' || text[0] > '9') return false;
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long number = strtoull(text.c_str(), &end, 10);
+    if (errno != 0) return false;
+    
+    unsigned shift = 0;
+    switch (*end) {
+        case 'K': case 'k':
+            shift = 10;
+            end++;
+            break;
+        case 'M': case 'm':
+            shift = 20;
+            end++;
+            break;
+        case 'G': case 'g':
+            shift = 30;
+            end++;
+            break;
+    }
+    if (*end != '\0' || number > (SIZE_MAX >> shift)) return false;
+    value = static_cast<size_t>(number) << shift;
+    return true;
+}
+
+//список через запятую; false - в списке есть неверный размер
+bool parseSizeList(const string& text, vector<size_t>& values) {
+    values.clear();
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        if (item.empty()) continue;
+        size_t value;
+        if (!parseSize(item, value)) return false;
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+void printUsage(const char* program) {
+    cerr << "Использование: " << program << " [параметры]\n"
+         << "  -s, --sizes      размеры входа через запятую (по умолчанию 64,1K,16K,256K,4M,64M)\n"
+         << "                   полный диапазон: 64,1K,16K,256K,4M,64M,1G\n"
+         << "  -k, --keys       длины ключа через запятую (по умолчанию 1,16,256,4096)\n"
+         << "  -m, --content    наборы данных: ascii,cyrillic,mixed,binary (по умолчанию все)\n"
+         << "  -c, --cipher     только указанный шифр (permutation, vigenere, gronsfeld)\n"
+         << "  -f, --function   только функции, содержащие подстроку (например Binary)\n"
+         << "  -t, --time       минимальное время замера в секундах (по умолчанию 0.2)\n"
+         << "  -j, --json       записать отчёт JSON в файл ('-' - стандартный вывод, таблица\n"
+         << "                   тогда выводится в поток ошибок)\n"
+         << "  -h, --help       эта справка" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    static const option longOptions[] = {
+        {"sizes", required_argument, nullptr, 's'},
+        {"keys", required_argument, nullptr, 'k'},
+        {"content", required_argument, nullptr, 'm'},
+        {"cipher", required_argument, nullptr, 'c'},
+        {"function", required_argument, nullptr, 'f'},
+        {"time", required_argument, nullptr, 't'},
+        {"json", required_argument, nullptr, 'j'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    
+    BenchmarkOptions options;
+    parseSizeList("64,1K,16K,256K,4M,64M", options.sizes);
+    parseSizeList("1,16,256,4096", options.keyLengths);
+    options.contents = {ContentMix::ASCII, ContentMix::CYRILLIC, ContentMix::MIXED, ContentMix::BINARY};
+    
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:k:m:c:f:t:j:h", longOptions, nullptr)) != -1) {
+        switch (opt) {
+            case 's':
+                if (!parseSizeList(optarg, options.sizes)) {
+                    cerr << "Неверный список размеров: " << optarg << endl;
+                    return 2;
+                }
+                break;
+            case 'k':
+                if (!parseSizeList(optarg, options.keyLengths)) {
+                    cerr << "Неверный список длин ключа: " << optarg << endl;
+                    return 2;
+                }
+                break;
+            case 'm': {
+                options.contents.clear();
+                stringstream stream(optarg);
+                string item;
+                while (getline(stream, item, ',')) {
+                    bool found = false;
+                    for (int i = 0; i < 4; i++) {
+                        if (item == CONTENT_NAMES[i]) {
+                            options.contents.push_back(static_cast<ContentMix>(i));
+                            found = true;
+                        }
+                    }
+                    if (!found) {
+                        cerr << "Неизвестный набор данных: " << item << endl;
+                        return 2;
+                    }
+                }
+                break;
+            }
+            case 'c':
+                options.cipherFilter = optarg;
+                break;
+            case 'f':
+                options.functionFilter = optarg;
+                break;
+            case 't': {
+                char* end = nullptr;
+                options.minSeconds = strtod(optarg, &end);
+                if (end == optarg || *end != '\0' || !(options.minSeconds >= 0)) {
+                    cerr << "Неверное время замера: " << optarg << endl;
+                    return 2;
+                }
+                break;
+            }
+            case 'j':
+                options.jsonFile = optarg;
+                break;
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                printUsage(argv[0]);
+                return 2;
+        }
+    }
+    
+    vector<BenchmarkCipher> allCiphers = {
+        {"permutation", "./libpermutation.so", "encryptPermutationText", "decryptPermutationText",
+         "encryptPermutationBinary", "decryptPermutationBinary", "permutationPluginDescriptor", false, false,
+         nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+        {"vigenere", "./libvigenere.so", "encryptVigenere", "decryptVigenere",
+         "encryptVigenereBinary", "decryptVigenereBinary", "vigenerePluginDescriptor", false, true,
+         nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+        {"gronsfeld", "./libgronsfeld.so", "encryptGronsfeld", "decryptGronsfeld",
+         "encryptGronsfeldBinary", "decryptGronsfeldBinary", "gronsfeldPluginDescriptor", true, true,
+         nullptr, nullptr, nullptr, nullptr, nullptr, nullptr}
+    };
+    
+    vector<BenchmarkCipher> ciphers;
+    for (BenchmarkCipher& cipher : allCiphers) {
+        if (!options.cipherFilter.empty() && options.cipherFilter != cipher.name) continue;
+        if (loadBenchmarkCipher(cipher)) ciphers.push_back(cipher);
+    }
+    if (ciphers.empty()) {
+        cerr << "Нет доступных библиотек шифров" << endl;
+        return 1;
+    }
+    
+    mt19937_64 random(42);
+    vector<BenchmarkResult> results;
+    
+    //при отчёте JSON в стандартный вывод таблица идёт в поток ошибок,
+    //чтобы вывод можно было передать дальше в конвейер
+    FILE* table = options.jsonFile == "-" ? stderr : stdout;
+    fprintf(table, "шифр         функция                    данные    размер     ключ  МБ/с       нс/байт   выдел./вызов\n");
+    for (ContentMix mix : options.contents) {
+        for (size_t size : options.sizes) {
+            string input = makeContent(mix, size, random);
+            
+            for (const BenchmarkCipher& cipher : ciphers) {
+                for (size_t keyLength : options.keyLengths) {
+                    string key = makeKey(cipher, keyLength, random);
+                    
+                    //дешифрование замеряется на результате шифрования того же входа
+                    string encryptedText = callText(cipher, cipher.encryptText, input, key);
+                    string encryptedBinary = cipher.encryptBinary(input, key);
+                    
+                    struct Case {
+                        const char* name;
+                        const string* input;
+                        function<string(const string&)> call;
+                    };
+                    Case cases[] = {
+                        {cipher.encryptTextName, &input,
+                         [&](const string& data) { return callText(cipher, cipher.encryptText, data, key); }},
+                        {cipher.decryptTextName, &encryptedText,
+                         [&](const string& data) { return callText(cipher, cipher.decryptText, data, key); }},
+                        {cipher.encryptBinaryName, &input,
+                         [&](const string& data) { return cipher.encryptBinary(data, key); }},
+                        {cipher.decryptBinaryName, &encryptedBinary,
+                         [&](const string& data) { return cipher.decryptBinary(data, key); }}
+                    };
+                    
+                    for (const Case& benchmarkCase : cases) {
+                        if (!options.functionFilter.empty() &&
+                            string(benchmarkCase.name).find(options.functionFilter) == string::npos) {
+                            continue;
+                        }
+                        
+                        BenchmarkResult result = measure(cipher.name, benchmarkCase.name, mix, *benchmarkCase.input,
+                                                         keyLength, options.minSeconds, benchmarkCase.call);
+                        results.push_back(result);
+                        
+                        fprintf(table, "%-12s %-26s %-9s %-10zu %-5zu %-10.1f %-9.3f %.1f\n", result.cipher.c_str(),
+                               result.function.c_str(), result.content.c_str(), result.size, result.keyLength,
+                               result.mbPerSecond, result.nsPerByte, result.allocationsPerCall);
+                        fflush(table);
+                    }
+                }
+            }
+        }
+    }
+    
+    if (!options.jsonFile.empty()) {
+        if (options.jsonFile == "-") {
+            writeJson(cout, ciphers, results);
+        } else {
+            ofstream out(options.jsonFile);
+            if (!out) {
+                cerr << "Не удалось создать файл " << options.jsonFile << endl;
+                return 1;
+            }
+            writeJson(out, ciphers, results);
+        }
+    }
+    
+    for (BenchmarkCipher& cipher : ciphers) {
+        dlclose(cipher.handle);
+    }
+    return 0;
+}
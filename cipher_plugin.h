@@ -0,0 +1,145 @@
+#ifndef CIPHER_PLUGIN_H
+#define CIPHER_PLUGIN_H
+
+/* Двоичный интерфейс библиотек шифров. Использует только типы C, поэтому
+   не зависит от стандартной библиотеки C++, с которой собраны программа
+   и библиотека. Функции не выбрасывают исключений, а возвращают CipherStatus */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* версия интерфейса; меняется при несовместимых изменениях описания.
+   Новые поля добавляются только в конец описания без смены версии: их
+   наличие определяется по structSize (CIPHER_PLUGIN_HAS_FIELD) */
+#define CIPHER_PLUGIN_ABI_VERSION 1
+
+/* результат функций шифра */
+enum CipherStatus {
+    CIPHER_OK = 0,
+    CIPHER_ERROR_INVALID_ARGUMENT = 1,  /* неверный ключ или данные */
+    CIPHER_ERROR_BUFFER_TOO_SMALL = 2,  /* выходной буфер меньше outputSize */
+    CIPHER_ERROR_NO_MEMORY = 3,
+    CIPHER_ERROR_UNSUPPORTED = 4,       /* режим не поддерживается шифром */
+    CIPHER_ERROR_INTERNAL = 5
+};
+
+/* возможности шифра (битовые флаги поля capabilities) */
+enum CipherCapability {
+    CIPHER_CAP_STREAMING = 1 << 0,        /* бинарные данные обрабатываются частями с offset */
+    CIPHER_CAP_IN_PLACE_BINARY = 1 << 1,  /* бинарный результат можно писать поверх входа */
+    CIPHER_CAP_IN_PLACE_TEXT = 1 << 2,    /* текстовый результат можно писать поверх входа */
+    CIPHER_CAP_PARALLEL_SAFE = 1 << 3     /* функции можно вызывать одновременно из разных потоков */
+};
+
+/* уровень векторизации, выбранный шифром на текущем процессоре */
+enum CipherSimdLevel {
+    CIPHER_SIMD_NONE = 0,
+    CIPHER_SIMD_SSE2 = 1,
+    CIPHER_SIMD_AVX2 = 2
+};
+
+/* правило размера результата */
+enum CipherSizeRule {
+    CIPHER_SIZE_SAME = 0,     /* результат всегда той же длины, что и вход */
+    CIPHER_SIZE_VARIABLE = 1  /* длина зависит от ключа и режима: буфер выделяется
+                                 по outputSize, фактическая длина - в written */
+};
+
+/* преобразование буфера data длиной length в out ёмкостью outCapacity.
+   offset - позиция data в общем потоке (не 0 только при CIPHER_CAP_STREAMING
+   и только для бинарных данных), в *written записывается длина результата */
+typedef int (*CipherTransformFunction)(const uint8_t* data, size_t length,
+                                       const uint8_t* key, size_t keyLength, uint64_t offset,
+                                       uint8_t* out, size_t outCapacity, size_t* written);
+
+/* счётчики кэша скомпилированных ключей */
+struct CipherKeyCacheStats {
+    uint64_t hits;            /* ключ найден в кэше */
+    uint64_t misses;          /* ключ разобран заново */
+    uint64_t entries;         /* ключей в кэше сейчас */
+    uint64_t capacity;        /* наибольшее число ключей в кэше */
+};
+
+/* операции, по которым шифр ведёт счётчики */
+enum CipherMetricOperation {
+    CIPHER_METRIC_ENCRYPT_TEXT = 0,
+    CIPHER_METRIC_DECRYPT_TEXT = 1,
+    CIPHER_METRIC_ENCRYPT_BINARY = 2,
+    CIPHER_METRIC_DECRYPT_BINARY = 3,
+    CIPHER_METRIC_OPERATIONS = 4
+};
+
+/* число корзин гистограммы задержек: корзина i - вызовы длительностью
+   от 2^i до 2^(i+1) нс, последняя - всё, что длиннее */
+#define CIPHER_LATENCY_BUCKETS 40
+
+/* счётчики одной операции */
+struct CipherOperationMetrics {
+    uint64_t calls;
+    uint64_t bytes;           /* входных байт */
+    uint64_t nanoseconds;     /* суммарное время вызовов */
+    uint64_t latency[CIPHER_LATENCY_BUCKETS];
+};
+
+/* счётчики шифра по операциям (индекс - CipherMetricOperation) */
+struct CipherMetrics {
+    struct CipherOperationMetrics operations[CIPHER_METRIC_OPERATIONS];
+};
+
+/* описание библиотеки шифра */
+struct CipherPluginDescriptor {
+    uint32_t abiVersion;      /* CIPHER_PLUGIN_ABI_VERSION, с которой собрана библиотека */
+    uint32_t structSize;      /* sizeof(CipherPluginDescriptor) в библиотеке */
+    const char* name;
+    uint32_t capabilities;    /* сочетание CipherCapability */
+    uint32_t simdLevel;       /* CipherSimdLevel */
+    uint32_t sizeRule;        /* CipherSizeRule */
+
+    /* размер выходного буфера, достаточный для результата в данном режиме */
+    size_t (*outputSize)(size_t length, const uint8_t* key, size_t keyLength, int decrypt, int binary);
+
+    CipherTransformFunction encryptBinary;
+    CipherTransformFunction decryptBinary;
+    CipherTransformFunction encryptText;
+    CipherTransformFunction decryptText;
+
+    /* параллельная обработка бинарных данных: threads потоков (0 - по числу ядер) */
+    void (*setParallelism)(unsigned threads, size_t minBytes);
+
+    /* текст последней ошибки в вызывающем потоке (UTF-8) */
+    const char* (*lastError)(void);
+
+    /* поля ниже добавлены после первой версии описания и есть не во всех
+       библиотеках: перед вызовом проверяется CIPHER_PLUGIN_HAS_FIELD */
+
+    /* состояние кэша скомпилированных ключей (сумма по всем режимам шифра) */
+    void (*keyCacheStats)(struct CipherKeyCacheStats* stats);
+
+    /* сбор счётчиков вызовов (по умолчанию выключен: замер времени
+       заметен на коротких сообщениях) и их текущие значения */
+    void (*setMetricsEnabled)(int enabled);
+    void (*metrics)(struct CipherMetrics* metrics);
+};
+
+/* размер описания первой версии (до lastError включительно): меньшее
+   описание с той же версией интерфейса не принимается */
+#define CIPHER_PLUGIN_BASE_SIZE \
+    (offsetof(struct CipherPluginDescriptor, lastError) + sizeof(((struct CipherPluginDescriptor*)0)->lastError))
+
+/* поле field есть в описании библиотеки (его покрывает structSize) и задано */
+#define CIPHER_PLUGIN_HAS_FIELD(descriptor, field) \
+    ((descriptor)->structSize >= offsetof(struct CipherPluginDescriptor, field) + sizeof((descriptor)->field) && \
+     (descriptor)->field != NULL)
+
+/* тип экспортируемой функции, возвращающей описание библиотеки */
+typedef const struct CipherPluginDescriptor* (*CipherPluginEntry)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
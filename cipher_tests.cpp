@@ -0,0 +1,460 @@
+//проверки согласованности путей обработки: каждый быстрый путь должен
+//давать тот же результат, что и простой вызов шифра.
+//Шифры компонуются в программу, как при сборке с CIPHER_STATIC_BUILD.
+//Сборка: g++ -std=c++17 -O2 -pthread cipher_tests.cpp permutation.cpp vigenere.cpp gronsfeld.cpp utils.cpp kernels.cpp thread_pool.cpp plugin_support.cpp metrics.cpp batch_io.cpp container.cpp file_pipeline.cpp program_metrics.cpp -o cipher_tests
+//Возвращает 0, если все проверки прошли
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <functional>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "cipher_plugin.h"
+#include "container.h"
+#include "batch_io.h"
+#include "permutation.h"
+#include "vigenere.h"
+#include "gronsfeld.h"
+
+using namespace std;
+
+//шифр под проверкой
+struct TestCipher {
+    const char* name;
+    uint32_t id;                //номер шифра, как в параметре -c
+    const char* key;
+    const CipherPluginDescriptor* descriptor;
+    function<void*(const string& key, bool decrypt, bool binary)> init;
+    function<string(void* ctx, const string& data)> update;
+    function<string(void* ctx)> final;
+};
+
+static int failures = 0;
+static int checks = 0;
+
+static void check(bool condition, const string& what) {
+    checks++;
+    if (condition) return;
+    failures++;
+    cerr << "ОШИБКА: " << what << endl;
+}
+
+static mt19937 rng(20240531);
+
+//случайные байты; в конце нули, чтобы длина не терялась на хвосте
+static string randomBinary(size_t length) {
+    string data(length, '\0');
+    for (size_t i = 0; i + 16 < length; i++) {
+        data[i] = static_cast<char>(rng() & 0xFF);
+    }
+    return data;
+}
+
+//текст из латиницы, кириллицы, цифр и знаков
+static string randomText(size_t symbols) {
+    static const char* const cyrillic[] = {"\xD0\x90", "\xD1\x8F", "\xD0\x81", "\xD1\x91", "\xD0\xB5", "\xD0\x9F"};
+    string text;
+    for (size_t i = 0; i < symbols; i++) {
+        unsigned kind = rng() % 3;
+        if (kind == 0) {
+            text += cyrillic[rng() % 6];
+        } else {
+            text += static_cast<char>(32 + rng() % 95);
+        }
+    }
+    return text;
+}
+
+//вызов функции описания; исключение, если шифр вернул ошибку
+static string callTransform(const TestCipher& cipher, bool decrypt, bool binary, const string& data, uint64_t offset = 0) {
+    const CipherPluginDescriptor* d = cipher.descriptor;
+    CipherTransformFunction transform = binary ? (decrypt ? d->decryptBinary : d->encryptBinary)
+                                               : (decrypt ? d->decryptText : d->encryptText);
+    const uint8_t* key = reinterpret_cast<const uint8_t*>(cipher.key);
+    size_t keyLength = strlen(cipher.key);
+    string out(d->outputSize(data.size(), key, keyLength, decrypt, binary), '\0');
+    size_t written = 0;
+    int status = transform(reinterpret_cast<const uint8_t*>(data.data()), data.size(), key, keyLength, offset,
+                           reinterpret_cast<uint8_t*>(&out[0]), out.size(), &written);
+    if (status != CIPHER_OK) throw runtime_error(string(cipher.name) + ": " + d->lastError());
+    out.resize(written);
+    return out;
+}
+
+//временный файл с произвольным доступом
+static int temporaryFile(const string& content) {
+    FILE* file = tmpfile();
+    if (!file) throw runtime_error("Не удалось создать временный файл");
+    int fd = dup(fileno(file));
+    fclose(file);
+    if (!content.empty() && pwrite(fd, content.data(), content.size(), 0) != static_cast<ssize_t>(content.size())) {
+        throw runtime_error("Ошибка записи во временный файл");
+    }
+    return fd;
+}
+
+static string readWholeFile(int fd) {
+    struct stat info;
+    fstat(fd, &info);
+    string content(static_cast<size_t>(info.st_size), '\0');
+    if (pread(fd, &content[0], content.size(), 0) != static_cast<ssize_t>(content.size())) {
+        throw runtime_error("Ошибка чтения временного файла");
+    }
+    return content;
+}
+
+//пошаговая обработка по одному байту совпадает с обработкой за один вызов
+//(контексты init/update/final и бинарные функции с позицией)
+static void testStreamingUpdates(const TestCipher& cipher) {
+    for (int binary = 0; binary < 2; binary++) {
+        string data = binary ? randomBinary(5000) : randomText(3000);
+        string encrypted = callTransform(cipher, false, binary, data);
+        
+        for (int decrypt = 0; decrypt < 2; decrypt++) {
+            const string& input = decrypt ? encrypted : data;
+            string expected = callTransform(cipher, decrypt, binary, input);
+            string what = string(cipher.name) + (binary ? " бинарные" : " текст") + (decrypt ? ", расшифровка" : ", шифрование");
+            
+            void* ctx = cipher.init(cipher.key, decrypt, binary);
+            string streamed;
+            for (size_t i = 0; i < input.size(); i++) {
+                streamed += cipher.update(ctx, input.substr(i, 1));
+            }
+            streamed += cipher.final(ctx);
+            check(streamed == expected, what + ": контекст по одному байту");
+            
+            if (binary && (cipher.descriptor->capabilities & CIPHER_CAP_STREAMING)) {
+                string pieces;
+                for (size_t i = 0; i < input.size(); i++) {
+                    pieces += callTransform(cipher, decrypt, true, input.substr(i, 1), i);
+                }
+                check(pieces == expected, what + ": вызовы по одному байту с позицией");
+            }
+        }
+    }
+}
+
+//кэш ключей: повторный ключ берётся из кэша, а вытесненный ключ после
+//повторного разбора даёт тот же результат
+static void testKeyCache(const TestCipher& cipher) {
+    string data = randomBinary(1000);
+    string first = callTransform(cipher, false, true, data);
+    
+    CipherKeyCacheStats before, after;
+    cipher.descriptor->keyCacheStats(&before);
+    string second = callTransform(cipher, false, true, data);
+    cipher.descriptor->keyCacheStats(&after);
+    check(second == first, string(cipher.name) + " кэш ключей: повторный вызов");
+    check(after.hits > before.hits, string(cipher.name) + " кэш ключей: повторный ключ не найден");
+    
+    //больше ключей, чем помещается в кэш
+    TestCipher other = cipher;
+    vector<string> keys;
+    for (uint64_t i = 0; i <= after.capacity; i++) {
+        keys.push_back(to_string(1000 + i));
+    }
+    for (const string& key : keys) {
+        other.key = key.c_str();
+        callTransform(other, false, true, data);
+    }
+    cipher.descriptor->keyCacheStats(&after);
+    check(after.entries <= after.capacity, string(cipher.name) + " кэш ключей: превышена ёмкость");
+    check(callTransform(cipher, false, true, data) == first, string(cipher.name) + " кэш ключей: после вытеснения");
+}
+
+//описание первой версии (structSize до lastError) принимается, а поля,
+//добавленные позже, считаются отсутствующими
+static void testDescriptorLayout(const TestCipher& cipher) {
+    const CipherPluginDescriptor* d = cipher.descriptor;
+    check(d->abiVersion == CIPHER_PLUGIN_ABI_VERSION && d->structSize >= CIPHER_PLUGIN_BASE_SIZE,
+          string(cipher.name) + ": описание не принимается");
+    check(CIPHER_PLUGIN_HAS_FIELD(d, keyCacheStats), string(cipher.name) + ": нет keyCacheStats");
+    check(CIPHER_PLUGIN_HAS_FIELD(d, setMetricsEnabled) && CIPHER_PLUGIN_HAS_FIELD(d, metrics),
+          string(cipher.name) + ": нет счётчиков вызовов");
+    
+    CipherPluginDescriptor first = *d;
+    first.structSize = CIPHER_PLUGIN_BASE_SIZE;
+    check(CIPHER_PLUGIN_HAS_FIELD(&first, lastError), string(cipher.name) + ": описание первой версии без lastError");
+    check(!CIPHER_PLUGIN_HAS_FIELD(&first, keyCacheStats), string(cipher.name) + ": keyCacheStats за пределами structSize");
+    check(!CIPHER_PLUGIN_HAS_FIELD(&first, setMetricsEnabled) && !CIPHER_PLUGIN_HAS_FIELD(&first, metrics),
+          string(cipher.name) + ": счётчики вызовов за пределами structSize");
+}
+
+//преобразование на месте совпадает с преобразованием в отдельный буфер
+static void testInPlace(const TestCipher& cipher) {
+    const CipherPluginDescriptor* d = cipher.descriptor;
+    const uint8_t* key = reinterpret_cast<const uint8_t*>(cipher.key);
+    size_t keyLength = strlen(cipher.key);
+    
+    for (int binary = 0; binary < 2; binary++) {
+        if (!(d->capabilities & (binary ? CIPHER_CAP_IN_PLACE_BINARY : CIPHER_CAP_IN_PLACE_TEXT))) continue;
+        for (int decrypt = 0; decrypt < 2; decrypt++) {
+            string data = binary ? randomBinary(70000) : randomText(30000);
+            uint64_t offset = binary ? rng() % 1000 : 0;
+            string expected = callTransform(cipher, decrypt, binary, data, offset);
+            
+            CipherTransformFunction transform = binary ? (decrypt ? d->decryptBinary : d->encryptBinary)
+                                                       : (decrypt ? d->decryptText : d->encryptText);
+            uint8_t* buffer = reinterpret_cast<uint8_t*>(&data[0]);
+            size_t written = 0;
+            int status = transform(buffer, data.size(), key, keyLength, offset, buffer, data.size(), &written);
+            data.resize(written);
+            check(status == CIPHER_OK && data == expected,
+                  string(cipher.name) + (binary ? " бинарные" : " текст") + (decrypt ? ", расшифровка" : ", шифрование") + " на месте");
+        }
+    }
+}
+
+//пакет io_uring: результаты совпадают с простым вызовом, файл больше
+//буфера откладывается, ошибка одного файла не мешает остальным
+static void testUringBatch(const TestCipher& cipher) {
+    char directoryTemplate[] = "/tmp/cipher_tests.XXXXXX";
+    const char* directory = mkdtemp(directoryTemplate);
+    if (!directory) throw runtime_error("Не удалось создать временный каталог");
+    
+    BatchOptions options;
+    options.bufferSize = 8192;
+    options.queueDepth = 4;
+    vector<BatchJob> jobs;
+    vector<string> inputs;
+    for (size_t i = 0; i < 20; i++) {
+        BatchJob job;
+        job.input = string(directory) + "/in" + to_string(i);
+        job.output = string(directory) + "/out" + to_string(i);
+        //последний файл больше буфера пакета
+        inputs.push_back(randomBinary(i == 19 ? options.bufferSize + 1 : i * 397));
+        int fd = open(job.input.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || write(fd, inputs[i].data(), inputs[i].size()) != static_cast<ssize_t>(inputs[i].size())) {
+            throw runtime_error("Ошибка записи " + job.input);
+        }
+        close(fd);
+        jobs.push_back(job);
+    }
+    BatchJob missing;
+    missing.input = string(directory) + "/нет";
+    missing.output = string(directory) + "/нет.out";
+    jobs.push_back(missing);
+    
+    BatchTransform transform = [&cipher](uint8_t* data, size_t length, uint8_t* out, size_t outCapacity) -> size_t {
+        const uint8_t* key = reinterpret_cast<const uint8_t*>(cipher.key);
+        size_t written = 0;
+        if (cipher.descriptor->encryptBinary(data, length, key, strlen(cipher.key), 0, out, outCapacity, &written) != CIPHER_OK) {
+            throw runtime_error(cipher.descriptor->lastError());
+        }
+        return written;
+    };
+    
+    if (!runUringBatch(jobs, options, transform)) {
+        cerr << "io_uring недоступен, проверка пакета пропущена" << endl;
+    } else {
+        for (size_t i = 0; i < inputs.size(); i++) {
+            string what = string(cipher.name) + " пакет io_uring, файл " + to_string(i);
+            if (i == 19) {
+                check(jobs[i].deferred && jobs[i].error.empty(), what + ": не отложен");
+                continue;
+            }
+            check(!jobs[i].deferred && jobs[i].error.empty(), what + ": " + jobs[i].error);
+            int fd = open(jobs[i].output.c_str(), O_RDONLY);
+            check(fd >= 0 && readWholeFile(fd) == callTransform(cipher, false, true, inputs[i]), what);
+            if (fd >= 0) close(fd);
+        }
+        check(!jobs.back().error.empty(), string(cipher.name) + " пакет io_uring: нет ошибки для отсутствующего файла");
+    }
+    
+    for (const BatchJob& job : jobs) {
+        unlink(job.input.c_str());
+        unlink(job.output.c_str());
+    }
+    rmdir(directory);
+}
+
+//контейнер: шифрование и расшифровка возвращают исходные данные при любом
+//размере блока, числе потоков и длине, не кратной блоку
+static void testContainerRoundTrip(const TestCipher& cipher) {
+    const size_t lengths[] = {0, 1, 1000, 4097, 70001};
+    const size_t chunkSizes[] = {3, 1000, 4096, CONTAINER_DEFAULT_CHUNK_SIZE};
+    const unsigned workers[] = {0, 4};
+    
+    for (size_t length : lengths) {
+        string data = randomBinary(length);
+        for (size_t chunkSize : chunkSizes) {
+            for (unsigned workerCount : workers) {
+                ContainerOptions options;
+                options.chunkSize = chunkSize;
+                options.workers = workerCount;
+                string what = string(cipher.name) + " контейнер: длина " + to_string(length) +
+                              ", блок " + to_string(chunkSize) + ", потоков " + to_string(workerCount);
+                
+                int inFd = temporaryFile(data);
+                int containerFd = temporaryFile("");
+                int outFd = temporaryFile("");
+                try {
+                    encryptContainer(inFd, containerFd, cipher.id, cipher.key, cipher.descriptor, options);
+                    decryptContainer(containerFd, outFd, cipher.id, cipher.key, cipher.descriptor, options);
+                    
+                    ContainerHeader header;
+                    vector<ContainerChunk> index;
+                    readContainerIndex(containerFd, header, index);
+                    check(header.originalLength == length && index.size() == header.chunkCount(), what + ": заголовок");
+                    check(readWholeFile(outFd) == data, what);
+                } catch (const exception& e) {
+                    check(false, what + ": " + e.what());
+                }
+                close(inFd);
+                close(containerFd);
+                close(outFd);
+            }
+        }
+    }
+}
+
+//диапазон: расшифровка части потока со своей позицией совпадает с той же
+//частью полной расшифровки (на этом построены --offset/--length)
+static void testRangeDecrypt(const TestCipher& cipher) {
+    if (!(cipher.descriptor->capabilities & CIPHER_CAP_STREAMING)) return;
+    
+    string data = randomBinary(100000);
+    string encrypted = callTransform(cipher, false, true, data);
+    string decrypted = callTransform(cipher, true, true, encrypted);
+    check(decrypted == data, string(cipher.name) + " диапазон: полная расшифровка");
+    
+    for (int i = 0; i < 200; i++) {
+        size_t offset = rng() % data.size();
+        size_t length = rng() % min<size_t>(data.size() - offset + 1, i % 2 ? 64 : 40000);
+        string part = callTransform(cipher, true, true, encrypted.substr(offset, length), offset);
+        check(part == decrypted.substr(offset, length),
+              string(cipher.name) + " диапазон " + to_string(offset) + "+" + to_string(length));
+    }
+}
+
+//командная строка: пакетная обработка (обычная и через io_uring) даёт тот же
+//результат, что и обработка одного файла с теми же параметрами. Запускается
+//собранная программа ./cipher_program рядом с библиотеками шифров
+static void testCommandLineBatch(const TestCipher& cipher) {
+    if (access("./cipher_program", X_OK) != 0) {
+        cerr << "./cipher_program не найден, проверка командной строки пропущена" << endl;
+        return;
+    }
+    char directoryTemplate[] = "/tmp/cipher_tests.XXXXXX";
+    const char* directory = mkdtemp(directoryTemplate);
+    if (!directory) throw runtime_error("Не удалось создать временный каталог");
+    string dir = directory;
+    
+    const char* const types[] = {"text", "binary"};
+    for (const char* type : types) {
+        bool binary = string(type) == "binary";
+        string content = binary ? randomBinary(3000) : randomText(500) + "\n";
+        string input = dir + "/input";
+        int fd = open(input.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || write(fd, content.data(), content.size()) != static_cast<ssize_t>(content.size())) {
+            throw runtime_error("Ошибка записи " + input);
+        }
+        close(fd);
+        
+        string options = " -c " + to_string(cipher.id) + " -e -k '" + cipher.key + "' -t " + type;
+        string commands[] = {
+            "./cipher_program" + options + " -i " + input + " -o " + dir + "/single",
+            "mkdir -p " + dir + "/batch && ./cipher_program" + options + " -b " + dir + "/batch " + input,
+            "mkdir -p " + dir + "/uring && ./cipher_program" + options + " --uring -b " + dir + "/uring " + input
+        };
+        for (const string& command : commands) {
+            check(system(command.c_str()) == 0, string(cipher.name) + ": " + command);
+        }
+        
+        string outputs[] = {dir + "/single", dir + "/batch/input", dir + "/uring/input"};
+        string results[3];
+        for (int i = 0; i < 3; i++) {
+            int outFd = open(outputs[i].c_str(), O_RDONLY);
+            if (outFd >= 0) {
+                results[i] = readWholeFile(outFd);
+                close(outFd);
+            }
+            unlink(outputs[i].c_str());
+        }
+        string what = string(cipher.name) + " командная строка (" + type + ")";
+        check(!results[0].empty(), what + ": нет результата");
+        check(results[1] == results[0], what + ": пакет отличается от одного файла");
+        check(results[2] == results[0], what + ": пакет io_uring отличается от одного файла");
+        unlink(input.c_str());
+    }
+    rmdir((dir + "/batch").c_str());
+    rmdir((dir + "/uring").c_str());
+    rmdir(directory);
+}
+
+//командная строка: -i f -o f с одним и тем же файлом даёт тот же результат,
+//что и запись в другой файл, и не портит вход раньше времени
+static void testCommandLineSameFile(const TestCipher& cipher) {
+    if (access("./cipher_program", X_OK) != 0) return;
+    char directoryTemplate[] = "/tmp/cipher_tests.XXXXXX";
+    const char* directory = mkdtemp(directoryTemplate);
+    if (!directory) throw runtime_error("Не удалось создать временный каталог");
+    string file = string(directory) + "/data";
+    string separate = string(directory) + "/separate";
+    
+    const char* const modes[] = {"", " --no-mmap"};
+    for (const char* mode : modes) {
+        string content = randomBinary(300000);
+        int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || write(fd, content.data(), content.size()) != static_cast<ssize_t>(content.size())) {
+            throw runtime_error("Ошибка записи " + file);
+        }
+        close(fd);
+        
+        string options = " -c " + to_string(cipher.id) + " -e -k '" + cipher.key + "' -t binary" + mode;
+        string what = string(cipher.name) + " командная строка, вход и выход совпадают" + mode;
+        check(system(("./cipher_program" + options + " -i " + file + " -o " + separate).c_str()) == 0, what);
+        check(system(("./cipher_program" + options + " -i " + file + " -o " + file).c_str()) == 0, what);
+        
+        int fileFd = open(file.c_str(), O_RDONLY);
+        int separateFd = open(separate.c_str(), O_RDONLY);
+        check(fileFd >= 0 && separateFd >= 0 && readWholeFile(fileFd) == readWholeFile(separateFd), what);
+        if (fileFd >= 0) close(fileFd);
+        if (separateFd >= 0) close(separateFd);
+    }
+    unlink(file.c_str());
+    unlink(separate.c_str());
+    rmdir(directory);
+}
+
+int main() {
+    TestCipher ciphers[] = {
+        {"permutation", 1, "31524", permutationPluginDescriptor(),
+         [](const string& key, bool decrypt, bool binary) -> void* { return permutationInit(key, decrypt, binary); },
+         [](void* ctx, const string& data) { return permutationUpdate(static_cast<PermutationContext*>(ctx), data); },
+         [](void* ctx) { return permutationFinal(static_cast<PermutationContext*>(ctx)); }},
+        {"vigenere", 2, "ключKey", vigenerePluginDescriptor(),
+         [](const string& key, bool decrypt, bool binary) -> void* { return vigenereInit(key, decrypt, binary); },
+         [](void* ctx, const string& data) { return vigenereUpdate(static_cast<VigenereContext*>(ctx), data); },
+         [](void* ctx) { return vigenereFinal(static_cast<VigenereContext*>(ctx)); }},
+        {"gronsfeld", 3, "31415", gronsfeldPluginDescriptor(),
+         [](const string& key, bool decrypt, bool binary) -> void* { return gronsfeldInit(key, decrypt, binary); },
+         [](void* ctx, const string& data) { return gronsfeldUpdate(static_cast<GronsfeldContext*>(ctx), data); },
+         [](void* ctx) { return gronsfeldFinal(static_cast<GronsfeldContext*>(ctx)); }}
+    };
+    
+    for (const TestCipher& cipher : ciphers) {
+        const function<void(const TestCipher&)> tests[] = {
+            testStreamingUpdates, testKeyCache, testDescriptorLayout, testInPlace, testUringBatch,
+            testContainerRoundTrip, testRangeDecrypt, testCommandLineBatch, testCommandLineSameFile
+        };
+        for (const auto& test : tests) {
+            try {
+                test(cipher);
+            } catch (const exception& e) {
+                check(false, string(cipher.name) + ": " + e.what());
+            }
+        }
+    }
+    
+    cout << "Проверок: " << checks << ", ошибок: " << failures << endl;
+    return failures == 0 ? 0 : 1;
+}
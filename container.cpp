@@ -0,0 +1,287 @@
+#include "container.h"
+#include "file_pipeline.h"
+#include "program_metrics.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char HEADER_MAGIC[8] = {'C', 'I', 'P', 'H', 'C', 'O', 'N', 'T'};
+static const char TRAILER_MAGIC[8] = {'C', 'I', 'P', 'H', 'I', 'N', 'D', 'X'};
+
+static void storeLittleEndian(uint8_t* target, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        target[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static uint64_t loadLittleEndian(const uint8_t* source, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(source[i]) << (8 * i);
+    }
+    return value;
+}
+
+static void encodeHeader(const ContainerHeader& header, uint8_t* data) {
+    memcpy(data, HEADER_MAGIC, sizeof(HEADER_MAGIC));
+    storeLittleEndian(data + 8, CONTAINER_VERSION, 4);
+    storeLittleEndian(data + 12, header.cipherId, 4);
+    storeLittleEndian(data + 16, header.originalLength, 8);
+    storeLittleEndian(data + 24, header.chunkSize, 4);
+    storeLittleEndian(data + 28, header.flags, 4);
+}
+
+//чтение count байт с позиции offset целиком
+static void readAt(int fd, uint8_t* data, size_t count, uint64_t offset) {
+    ScopedMetric metric(programMetrics(), PROGRAM_METRIC_READ, count);
+    while (count > 0) {
+        ssize_t n = pread(fd, data, count, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error(string("Ошибка чтения: ") + strerror(errno));
+        }
+        if (n == 0) throw runtime_error("Контейнер повреждён: блок за концом файла");
+        data += n;
+        count -= n;
+        offset += n;
+    }
+}
+
+//запись count байт с позиции offset целиком
+static void writeAt(int fd, const uint8_t* data, size_t count, uint64_t offset) {
+    ScopedMetric metric(programMetrics(), PROGRAM_METRIC_WRITE, count);
+    while (count > 0) {
+        ssize_t n = pwrite(fd, data, count, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error(string("Ошибка записи: ") + strerror(errno));
+        }
+        data += n;
+        count -= n;
+        offset += n;
+    }
+}
+
+//ошибка функции буферного интерфейса шифра
+static void checkStatus(int status, const CipherPluginDescriptor* descriptor) {
+    if (status != CIPHER_OK) {
+        throw runtime_error(descriptor->lastError());
+    }
+}
+
+//может ли шифр писать результат поверх входа
+static bool inPlace(const CipherPluginDescriptor* descriptor) {
+    return (descriptor->capabilities & CIPHER_CAP_IN_PLACE_BINARY) && descriptor->sizeRule == CIPHER_SIZE_SAME;
+}
+
+//параметры конвейера для независимых блоков: шифр, допускающий
+//одновременные вызовы, обрабатывает несколько блоков сразу
+static PipelineOptions containerPipeline(const CipherPluginDescriptor* descriptor, const ContainerOptions& options) {
+    PipelineOptions pipeline;
+    pipeline.chunkSize = options.chunkSize;
+    pipeline.workers = options.workers;
+    if (pipeline.workers > 1 && !(descriptor->capabilities & CIPHER_CAP_PARALLEL_SAFE)) pipeline.workers = 1;
+    return pipeline;
+}
+
+void encryptContainer(int inFd, int outFd, uint32_t cipherId, const string& key,
+                      const CipherPluginDescriptor* descriptor, const ContainerOptions& options) {
+    if (key.empty()) throw runtime_error("Ключ не должен быть пустым");
+    if (options.chunkSize == 0 || options.chunkSize > CONTAINER_MAX_CHUNK_SIZE) {
+        throw invalid_argument("Недопустимый размер блока контейнера");
+    }
+    
+    ContainerHeader header;
+    header.cipherId = cipherId;
+    header.chunkSize = static_cast<uint32_t>(options.chunkSize);
+    header.flags = (descriptor->capabilities & CIPHER_CAP_STREAMING) ? CONTAINER_FLAG_POSITIONAL : 0;
+    
+    //длина известна заранее только для обычного файла; иначе заголовок
+    //переписывается в конце, для чего нужен выход с произвольным доступом
+    struct stat info;
+    off_t inputPosition = lseek(inFd, 0, SEEK_CUR);
+    bool lengthKnown = fstat(inFd, &info) == 0 && S_ISREG(info.st_mode) && inputPosition >= 0;
+    off_t headerPosition = lseek(outFd, 0, SEEK_CUR);
+    if (!lengthKnown && headerPosition < 0) {
+        throw runtime_error("Длина входных данных неизвестна: контейнер можно записать только в файл");
+    }
+    if (lengthKnown) header.originalLength = info.st_size - inputPosition;
+    
+    uint8_t headerData[CONTAINER_HEADER_SIZE];
+    encodeHeader(header, headerData);
+    writeAll(outFd, reinterpret_cast<const char*>(headerData), sizeof(headerData));
+    
+    CipherTransformFunction transform = descriptor->encryptBinary;
+    const uint8_t* keyData = reinterpret_cast<const uint8_t*>(key.data());
+    bool positional = (header.flags & CONTAINER_FLAG_POSITIONAL) != 0;
+    bool sameBuffer = inPlace(descriptor);
+    
+    //длины зашифрованных блоков по номерам; рабочие потоки заканчивают
+    //блоки не по порядку
+    vector<uint64_t> chunkLengths;
+    mutex chunkLengthsGuard;
+    uint64_t originalLength = 0;
+    
+    runFilePipeline(inFd, outFd, containerPipeline(descriptor, options), [&](PipelineChunk& chunk) {
+        uint8_t* data = reinterpret_cast<uint8_t*>(&chunk.buffer[0]);
+        uint8_t* out = data;
+        size_t capacity = chunk.buffer.size();
+        if (!sameBuffer) {
+            chunk.output.resize(descriptor->outputSize(chunk.length, keyData, key.size(), 0, 1));
+            out = reinterpret_cast<uint8_t*>(&chunk.output[0]);
+            capacity = chunk.output.size();
+        }
+        
+        size_t written = 0;
+        {
+            ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, chunk.length);
+            checkStatus(transform(data, chunk.length, keyData, key.size(), positional ? chunk.offset : 0,
+                                  out, capacity, &written), descriptor);
+        }
+        chunk.result = reinterpret_cast<const char*>(out);
+        chunk.resultLength = written;
+        
+        lock_guard<mutex> lock(chunkLengthsGuard);
+        if (chunkLengths.size() <= chunk.sequence) chunkLengths.resize(chunk.sequence + 1);
+        chunkLengths[chunk.sequence] = written;
+        originalLength = max<uint64_t>(originalLength, chunk.offset + chunk.length);
+    });
+    
+    //индекс и окончание
+    vector<uint8_t> index(chunkLengths.size() * CONTAINER_INDEX_ENTRY_SIZE + CONTAINER_TRAILER_SIZE);
+    uint64_t offset = CONTAINER_HEADER_SIZE;
+    for (size_t i = 0; i < chunkLengths.size(); i++) {
+        storeLittleEndian(&index[i * CONTAINER_INDEX_ENTRY_SIZE], offset, 8);
+        storeLittleEndian(&index[i * CONTAINER_INDEX_ENTRY_SIZE + 8], chunkLengths[i], 8);
+        offset += chunkLengths[i];
+    }
+    uint8_t* trailer = &index[chunkLengths.size() * CONTAINER_INDEX_ENTRY_SIZE];
+    storeLittleEndian(trailer, offset, 8);
+    memcpy(trailer + 8, TRAILER_MAGIC, sizeof(TRAILER_MAGIC));
+    writeAll(outFd, reinterpret_cast<const char*>(index.data()), index.size());
+    
+    if (originalLength != header.originalLength) {
+        if (headerPosition < 0) throw runtime_error("Длина входных данных изменилась во время записи контейнера");
+        header.originalLength = originalLength;
+        encodeHeader(header, headerData);
+        writeAt(outFd, headerData, sizeof(headerData), headerPosition);
+    }
+}
+
+void readContainerIndex(int fd, ContainerHeader& header, vector<ContainerChunk>& index) {
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        throw runtime_error("Контейнер читается только из файла");
+    }
+    uint64_t fileSize = info.st_size;
+    if (fileSize < CONTAINER_HEADER_SIZE + CONTAINER_TRAILER_SIZE) {
+        throw runtime_error("Файл не является контейнером");
+    }
+    
+    uint8_t headerData[CONTAINER_HEADER_SIZE];
+    uint8_t trailer[CONTAINER_TRAILER_SIZE];
+    readAt(fd, headerData, sizeof(headerData), 0);
+    readAt(fd, trailer, sizeof(trailer), fileSize - CONTAINER_TRAILER_SIZE);
+    if (memcmp(headerData, HEADER_MAGIC, sizeof(HEADER_MAGIC)) != 0 ||
+        memcmp(trailer + 8, TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) != 0) {
+        throw runtime_error("Файл не является контейнером");
+    }
+    if (loadLittleEndian(headerData + 8, 4) != CONTAINER_VERSION) {
+        throw runtime_error("Неподдерживаемая версия контейнера");
+    }
+    
+    header.cipherId = static_cast<uint32_t>(loadLittleEndian(headerData + 12, 4));
+    header.originalLength = loadLittleEndian(headerData + 16, 8);
+    header.chunkSize = static_cast<uint32_t>(loadLittleEndian(headerData + 24, 4));
+    header.flags = static_cast<uint32_t>(loadLittleEndian(headerData + 28, 4));
+    if (header.chunkSize == 0 || header.chunkSize > CONTAINER_MAX_CHUNK_SIZE) {
+        throw runtime_error("Контейнер повреждён: недопустимый размер блока");
+    }
+    
+    //индекс занимает всё место между последним блоком и окончанием
+    uint64_t indexOffset = loadLittleEndian(trailer, 8);
+    uint64_t count = header.chunkCount();
+    if (indexOffset < CONTAINER_HEADER_SIZE || indexOffset > fileSize - CONTAINER_TRAILER_SIZE ||
+        (fileSize - CONTAINER_TRAILER_SIZE - indexOffset) / CONTAINER_INDEX_ENTRY_SIZE != count ||
+        (fileSize - CONTAINER_TRAILER_SIZE - indexOffset) % CONTAINER_INDEX_ENTRY_SIZE != 0) {
+        throw runtime_error("Контейнер повреждён: индекс не соответствует заголовку");
+    }
+    
+    vector<uint8_t> entries(count * CONTAINER_INDEX_ENTRY_SIZE);
+    if (count > 0) readAt(fd, entries.data(), entries.size(), indexOffset);
+    index.assign(count, ContainerChunk());
+    for (uint64_t i = 0; i < count; i++) {
+        index[i].offset = loadLittleEndian(&entries[i * CONTAINER_INDEX_ENTRY_SIZE], 8);
+        index[i].length = loadLittleEndian(&entries[i * CONTAINER_INDEX_ENTRY_SIZE + 8], 8);
+        if (index[i].offset < CONTAINER_HEADER_SIZE || index[i].offset > indexOffset ||
+            index[i].length > indexOffset - index[i].offset) {
+            throw runtime_error("Контейнер повреждён: блок за пределами данных");
+        }
+    }
+}
+
+void decryptContainer(int inFd, int outFd, uint32_t cipherId, const string& key,
+                      const CipherPluginDescriptor* descriptor, const ContainerOptions& options) {
+    if (key.empty()) throw runtime_error("Ключ не должен быть пустым");
+    
+    ContainerHeader header;
+    vector<ContainerChunk> index;
+    readContainerIndex(inFd, header, index);
+    if (header.cipherId != cipherId) {
+        throw runtime_error("Контейнер зашифрован другим шифром (номер " + to_string(header.cipherId) + ")");
+    }
+    bool positional = (header.flags & CONTAINER_FLAG_POSITIONAL) != 0;
+    if (positional && !(descriptor->capabilities & CIPHER_CAP_STREAMING)) {
+        throw runtime_error("Контейнер требует потокового шифра");
+    }
+    
+    CipherTransformFunction transform = descriptor->decryptBinary;
+    const uint8_t* keyData = reinterpret_cast<const uint8_t*>(key.data());
+    bool sameBuffer = inPlace(descriptor);
+    
+    PipelineOptions pipeline = containerPipeline(descriptor, options);
+    pipeline.reader = [&](PipelineChunk& chunk) {
+        if (chunk.sequence >= index.size()) return false;
+        const ContainerChunk& entry = index[chunk.sequence];
+        chunk.buffer.resize(entry.length);
+        chunk.length = entry.length;
+        chunk.offset = chunk.sequence * header.chunkSize;
+        if (entry.length > 0) readAt(inFd, reinterpret_cast<uint8_t*>(&chunk.buffer[0]), entry.length, entry.offset);
+        return true;
+    };
+    
+    runFilePipeline(-1, outFd, pipeline, [&](PipelineChunk& chunk) {
+        size_t expected = header.chunkLength(chunk.sequence);
+        uint8_t* data = reinterpret_cast<uint8_t*>(&chunk.buffer[0]);
+        uint8_t* out = data;
+        size_t capacity = chunk.buffer.size();
+        if (!sameBuffer) {
+            chunk.output.resize(max(expected, descriptor->outputSize(chunk.length, keyData, key.size(), 1, 1)));
+            out = reinterpret_cast<uint8_t*>(&chunk.output[0]);
+            capacity = chunk.output.size();
+        }
+        
+        size_t written = 0;
+        {
+            ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, chunk.length);
+            checkStatus(transform(data, chunk.length, keyData, key.size(), positional ? chunk.offset : 0,
+                                  out, capacity, &written), descriptor);
+        }
+        
+        //шифр с дополнением блока отбрасывает нулевые байты в конце вместе
+        //с дополнением; длина блока известна, поэтому исходные нули возвращаются
+        if (written > expected || (written < expected && sameBuffer)) {
+            throw runtime_error("Контейнер повреждён: длина блока " + to_string(chunk.sequence) +
+                                " не совпадает с заголовком");
+        }
+        memset(out + written, 0, expected - written);
+        chunk.result = reinterpret_cast<const char*>(out);
+        chunk.resultLength = expected;
+    });
+}
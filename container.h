@@ -0,0 +1,94 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "cipher_plugin.h"
+
+using namespace std;
+
+/* Формат контейнера (все числа little-endian):
+   заголовок (CONTAINER_HEADER_SIZE байт)
+     0  8  "CIPHCONT"
+     8  4  версия формата (CONTAINER_VERSION)
+     12 4  номер шифра (как в параметре -c)
+     16 8  длина исходных данных
+     24 4  размер блока исходных данных
+     28 4  флаги (CONTAINER_FLAG_*)
+   блоки: каждый блок исходных данных зашифрован отдельно
+   индекс: для каждого блока смещение в файле (8) и длина (8)
+   окончание (CONTAINER_TRAILER_SIZE байт)
+     0  8  смещение индекса
+     8  8  "CIPHINDX"
+   Любой блок расшифровывается независимо от остальных, а точная длина
+   исходных данных известна без расшифровки */
+
+const uint32_t CONTAINER_VERSION = 1;
+const size_t CONTAINER_HEADER_SIZE = 32;
+const size_t CONTAINER_INDEX_ENTRY_SIZE = 16;
+const size_t CONTAINER_TRAILER_SIZE = 16;
+
+//размер блока по умолчанию и наибольший допустимый
+const size_t CONTAINER_DEFAULT_CHUNK_SIZE = 1 << 20;
+const size_t CONTAINER_MAX_CHUNK_SIZE = 1 << 30;
+
+//блоки зашифрованы со своей позицией в исходных данных (потоковые шифры);
+//без флага каждый блок шифруется как отдельное сообщение
+const uint32_t CONTAINER_FLAG_POSITIONAL = 1 << 0;
+
+//заголовок контейнера
+struct ContainerHeader {
+    uint32_t cipherId;
+    uint64_t originalLength;
+    uint32_t chunkSize;
+    uint32_t flags;
+    
+    ContainerHeader() : cipherId(0), originalLength(0), chunkSize(0), flags(0) {}
+    
+    uint64_t chunkCount() const { return chunkSize ? (originalLength + chunkSize - 1) / chunkSize : 0; }
+    
+    //длина исходных данных блока index
+    size_t chunkLength(uint64_t index) const {
+        uint64_t begin = index * chunkSize;
+        return static_cast<size_t>(min<uint64_t>(chunkSize, originalLength - begin));
+    }
+};
+
+//запись индекса: где лежит зашифрованный блок
+struct ContainerChunk {
+    uint64_t offset;
+    uint64_t length;
+    
+    ContainerChunk() : offset(0), length(0) {}
+};
+
+//параметры обработки контейнера
+struct ContainerOptions {
+    size_t chunkSize;       //размер блока при шифровании
+    unsigned workers;       //потоков шифра для разных блоков; 0 - чтение,
+                            //шифрование и запись по очереди в текущем потоке
+    
+    ContainerOptions() : chunkSize(CONTAINER_DEFAULT_CHUNK_SIZE), workers(1) {}
+};
+
+//шифрование данных inFd в контейнер в outFd через буферный интерфейс шифра.
+//Длина данных берётся из размера входного файла; если вход - не обычный
+//файл, заголовок переписывается в конце, и выход должен допускать
+//произвольный доступ
+void encryptContainer(int inFd, int outFd, uint32_t cipherId, const string& key,
+                      const CipherPluginDescriptor* descriptor, const ContainerOptions& options);
+
+//чтение и проверка заголовка и индекса контейнера (вход должен допускать
+//произвольный доступ)
+void readContainerIndex(int fd, ContainerHeader& header, vector<ContainerChunk>& index);
+
+//расшифровка контейнера из inFd в outFd; блоки читаются по индексу,
+//расшифровываются параллельно и пишутся по порядку
+void decryptContainer(int inFd, int outFd, uint32_t cipherId, const string& key,
+                      const CipherPluginDescriptor* descriptor, const ContainerOptions& options);
+
+#endif
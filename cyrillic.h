@@ -0,0 +1,69 @@
+#ifndef CYRILLIC_H
+#define CYRILLIC_H
+
+//таблицы кириллицы UTF-8, вычисляемые на этапе компиляции.
+//Порядок букв совпадает с getCyrillicAlphabet: А-Е, Ё, Ж-Я (и так же для строчных)
+
+const int CYRILLIC_ALPHABET_SIZE = 33;
+
+//кириллическая буква как пара байт UTF-8
+struct CyrillicLetter {
+    unsigned char lead;
+    unsigned char trail;
+};
+
+//буква по позиции в алфавите нужного регистра
+constexpr CyrillicLetter cyrillicLetterAt(bool isUpper, int pos) {
+    if (isUpper) {
+        if (pos < 6) return {0xD0, static_cast<unsigned char>(0x90 + pos)};            //А-Е
+        if (pos == 6) return {0xD0, 0x81};                                              //Ё
+        return {0xD0, static_cast<unsigned char>(0x96 + pos - 7)};                      //Ж-Я
+    }
+    if (pos < 6) return {0xD0, static_cast<unsigned char>(0xB0 + pos)};                //а-е
+    if (pos == 6) return {0xD1, 0x91};                                                  //ё
+    if (pos < 17) return {0xD0, static_cast<unsigned char>(0xB6 + pos - 7)};            //ж-п
+    return {0xD1, static_cast<unsigned char>(0x80 + pos - 17)};                         //р-я
+}
+
+//таблица сдвигов: для каждой пары (первый байт 0xD0/0xD1, второй байт 0x80-0xBF)
+//хранит букву того же регистра, сдвинутую на 0..32 позиции вперёд.
+//Для пар, не являющихся буквами алфавита, isLetter == false
+struct CyrillicShiftTable {
+    bool isLetter[2][64];
+    int position[2][64];
+    CyrillicLetter shifted[2][64][CYRILLIC_ALPHABET_SIZE];
+};
+
+constexpr CyrillicShiftTable buildCyrillicShiftTable() {
+    CyrillicShiftTable table{};
+    for (int upper = 0; upper < 2; upper++) {
+        for (int pos = 0; pos < CYRILLIC_ALPHABET_SIZE; pos++) {
+            CyrillicLetter letter = cyrillicLetterAt(upper == 1, pos);
+            int lead = letter.lead - 0xD0;
+            int trail = letter.trail - 0x80;
+            table.isLetter[lead][trail] = true;
+            table.position[lead][trail] = pos;
+            for (int shift = 0; shift < CYRILLIC_ALPHABET_SIZE; shift++) {
+                table.shifted[lead][trail][shift] = cyrillicLetterAt(upper == 1, (pos + shift) % CYRILLIC_ALPHABET_SIZE);
+            }
+        }
+    }
+    return table;
+}
+
+inline constexpr CyrillicShiftTable CYRILLIC_SHIFT_TABLE = buildCyrillicShiftTable();
+
+//строка сдвигов для буквы (lead, trail) или nullptr, если это не буква алфавита
+inline const CyrillicLetter* cyrillicShiftRow(unsigned char lead, unsigned char trail) {
+    if ((lead != 0xD0 && lead != 0xD1) || trail < 0x80 || trail > 0xBF) return nullptr;
+    if (!CYRILLIC_SHIFT_TABLE.isLetter[lead - 0xD0][trail - 0x80]) return nullptr;
+    return CYRILLIC_SHIFT_TABLE.shifted[lead - 0xD0][trail - 0x80];
+}
+
+//позиция буквы (lead, trail) в алфавите её регистра или -1
+inline int cyrillicPosition(unsigned char lead, unsigned char trail) {
+    if (!cyrillicShiftRow(lead, trail)) return -1;
+    return CYRILLIC_SHIFT_TABLE.position[lead - 0xD0][trail - 0x80];
+}
+
+#endif
@@ -0,0 +1,225 @@
+#include "file_pipeline.h"
+#include "program_metrics.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+size_t readFull(int fd, char* buffer, size_t size) {
+    ScopedMetric metric(programMetrics(), PROGRAM_METRIC_READ, 0);
+    size_t total = 0;
+    while (total < size) {
+        ssize_t n = read(fd, buffer + total, size - total);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error(string("Ошибка чтения: ") + strerror(errno));
+        }
+        if (n == 0) break;
+        total += n;
+    }
+    metric.setBytes(total);
+    return total;
+}
+
+void writeAll(int fd, const char* data, size_t size) {
+    ScopedMetric metric(programMetrics(), PROGRAM_METRIC_WRITE, size);
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error(string("Ошибка записи: ") + strerror(errno));
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+//чтение очередного блока (sequence и offset уже заданы). Возвращает false,
+//если блока нет; last - блок последний
+static bool readChunk(int inFd, const PipelineOptions& options, PipelineChunk& chunk, bool& last) {
+    if (options.reader) {
+        bool filled = options.reader(chunk);
+        last = !filled;
+        return filled;
+    }
+    
+    if (chunk.buffer.size() != options.chunkSize) chunk.buffer.resize(options.chunkSize);
+    chunk.length = readFull(inFd, &chunk.buffer[0], options.chunkSize);
+    //неполный блок бывает только в конце данных
+    last = chunk.length < options.chunkSize;
+    return chunk.length > 0;
+}
+
+//кольцо буферов конвейера. Блок с номером n всегда лежит в ячейке n % depth,
+//поэтому писатель забирает блоки по порядку, даже если рабочие потоки
+//закончили их не по порядку. Ячейка проходит состояния
+//FREE -> READ -> TRANSFORMING -> DONE -> FREE
+class ChunkRing {
+public:
+    ChunkRing(int inFd, int outFd, const PipelineOptions& options, const ChunkTransform& transform)
+        : inFd(inFd), outFd(outFd), options(options), transform(transform),
+          slots(max(options.depth, static_cast<size_t>(options.workers) + 2)),
+          states(slots.size(), FREE), readCount(0), transformCount(0), endOfInput(false), failed(false) {}
+    
+    uint64_t run() {
+        vector<thread> threads;
+        try {
+            threads.emplace_back([this] { guarded([this] { readerLoop(); }); });
+            for (unsigned i = 0; i < options.workers; i++) {
+                threads.emplace_back([this] { guarded([this] { workerLoop(); }); });
+            }
+        } catch (...) {
+            fail(current_exception());
+        }
+        
+        uint64_t written = 0;
+        guarded([&] { written = writerLoop(); });
+        
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        if (error) rethrow_exception(error);
+        return written;
+    }
+
+private:
+    enum SlotState { FREE, READ, TRANSFORMING, DONE };
+    
+    //выполняет этап; исключение останавливает весь конвейер
+    template <typename Stage>
+    void guarded(Stage stage) {
+        try {
+            stage();
+        } catch (...) {
+            fail(current_exception());
+        }
+    }
+    
+    void fail(exception_ptr stageError) {
+        lock_guard<mutex> lock(guard);
+        if (!error) error = stageError;
+        failed = true;
+        changed.notify_all();
+    }
+    
+    void readerLoop() {
+        uint64_t offset = 0;
+        for (uint64_t sequence = 0; ; sequence++) {
+            size_t slot = sequence % slots.size();
+            {
+                unique_lock<mutex> lock(guard);
+                changed.wait(lock, [&] { return failed || states[slot] == FREE; });
+                if (failed) return;
+            }
+            
+            PipelineChunk& chunk = slots[slot];
+            chunk.sequence = sequence;
+            chunk.offset = offset;
+            bool last;
+            bool filled = readChunk(inFd, options, chunk, last);
+            
+            lock_guard<mutex> lock(guard);
+            if (filled) {
+                states[slot] = READ;
+                readCount = sequence + 1;
+                offset += chunk.length;
+            }
+            if (last) endOfInput = true;
+            changed.notify_all();
+            if (endOfInput) return;
+        }
+    }
+    
+    void workerLoop() {
+        while (true) {
+            uint64_t sequence;
+            {
+                unique_lock<mutex> lock(guard);
+                changed.wait(lock, [&] { return failed || transformCount < readCount || endOfInput; });
+                if (failed || transformCount == readCount) return;
+                sequence = transformCount++;
+                states[sequence % slots.size()] = TRANSFORMING;
+            }
+            
+            PipelineChunk& chunk = slots[sequence % slots.size()];
+            chunk.result = nullptr;
+            chunk.resultLength = 0;
+            transform(chunk);
+            
+            lock_guard<mutex> lock(guard);
+            states[sequence % slots.size()] = DONE;
+            changed.notify_all();
+        }
+    }
+    
+    uint64_t writerLoop() {
+        uint64_t written = 0;
+        for (uint64_t sequence = 0; ; sequence++) {
+            size_t slot = sequence % slots.size();
+            {
+                unique_lock<mutex> lock(guard);
+                changed.wait(lock, [&] {
+                    return failed || states[slot] == DONE || (endOfInput && sequence == readCount);
+                });
+                if (failed || states[slot] != DONE) return written;
+            }
+            
+            PipelineChunk& chunk = slots[slot];
+            writeAll(outFd, chunk.result, chunk.resultLength);
+            written += chunk.resultLength;
+            
+            lock_guard<mutex> lock(guard);
+            states[slot] = FREE;
+            changed.notify_all();
+        }
+    }
+    
+    int inFd;
+    int outFd;
+    const PipelineOptions& options;
+    const ChunkTransform& transform;
+    
+    vector<PipelineChunk> slots;
+    vector<SlotState> states;
+    uint64_t readCount;         //прочитано блоков
+    uint64_t transformCount;    //выдано рабочим потокам
+    bool endOfInput;
+    bool failed;
+    exception_ptr error;
+    mutex guard;
+    condition_variable changed;
+};
+
+uint64_t runFilePipeline(int inFd, int outFd, const PipelineOptions& options, const ChunkTransform& transform) {
+    if (options.chunkSize == 0) {
+        throw invalid_argument("Размер блока конвейера должен быть больше нуля");
+    }
+    
+    if (options.workers == 0) {
+        PipelineChunk chunk;
+        uint64_t written = 0;
+        while (true) {
+            bool last;
+            if (!readChunk(inFd, options, chunk, last)) break;
+            
+            transform(chunk);
+            writeAll(outFd, chunk.result, chunk.resultLength);
+            written += chunk.resultLength;
+            if (last) break;
+            chunk.offset += chunk.length;
+            chunk.sequence++;
+        }
+        return written;
+    }
+    
+    ChunkRing ring(inFd, outFd, options, transform);
+    return ring.run();
+}
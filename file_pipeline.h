@@ -0,0 +1,59 @@
+#ifndef FILE_PIPELINE_H
+#define FILE_PIPELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+using namespace std;
+
+//блок данных конвейера. Буферы блоков создаются один раз и переходят
+//по кругу от читателя к рабочим потокам и к писателю
+struct PipelineChunk {
+    string buffer;          //прочитанные данные (первые length байт)
+    size_t length;
+    uint64_t offset;        //позиция блока во входном потоке
+    uint64_t sequence;      //номер блока
+    string output;          //результат, если он пишется не на место buffer
+    const char* result;     //что записать: buffer, output или другие данные
+    size_t resultLength;
+    
+    PipelineChunk() : length(0), offset(0), sequence(0), result(nullptr), resultLength(0) {}
+};
+
+//преобразование блока; должно заполнить result и resultLength.
+//При нескольких рабочих потоках вызывается одновременно для разных блоков,
+//при одном - строго по порядку блоков
+typedef function<void(PipelineChunk&)> ChunkTransform;
+
+//источник блоков вместо последовательного чтения входного дескриптора:
+//заполняет блок с номером chunk.sequence (buffer, length и offset) и
+//возвращает false, когда блоков больше нет. Вызывается по порядку блоков
+typedef function<bool(PipelineChunk&)> ChunkReader;
+
+//параметры конвейера
+struct PipelineOptions {
+    size_t chunkSize;       //размер блока чтения
+    unsigned workers;       //число потоков преобразования; 0 - без конвейера:
+                            //чтение, преобразование и запись по очереди в текущем потоке
+    size_t depth;           //число буферов в обороте (не меньше workers + 2)
+    ChunkReader reader;     //пусто - блоки по chunkSize байт читаются из inFd подряд
+    
+    PipelineOptions() : chunkSize(1 << 20), workers(1), depth(4) {}
+};
+
+//чтение до size байт из дескриптора (меньше - только в конце данных)
+size_t readFull(int fd, char* buffer, size_t size);
+
+//запись всех байт в дескриптор
+void writeAll(int fd, const char* data, size_t size);
+
+//конвейер чтение -> преобразование -> запись: поток чтения заполняет свободные
+//буферы кольца, рабочие потоки преобразуют их, текущий поток пишет результаты
+//в порядке блоков и возвращает буферы читателю. Чтение, шифрование и запись
+//разных блоков идут одновременно. Ошибка любого этапа останавливает конвейер
+//и передаётся вызывающему. Возвращает число записанных байт
+uint64_t runFilePipeline(int inFd, int outFd, const PipelineOptions& options, const ChunkTransform& transform);
+
+#endif
@@ -1,5 +1,11 @@
 #include "gronsfeld.h"
 #include "utils.h"
+#include "kernels.h"
+#include "cyrillic.h"
+#include "thread_pool.h"
+#include "plugin_support.h"
+#include "key_cache.h"
+#include "metrics.h"
 #include <vector>
 #include <string>
 #include <algorithm>
@@ -8,8 +14,8 @@
 using namespace std;
 
 //парсирование ключа
-vector<int> parseKey(const string& keyStr) {
-    vector<int> result;
+vector<unsigned char> parseKey(const string& keyStr) {
+    vector<unsigned char> result;
     for (char c : keyStr) {
         if (c >= '0' && c <= '9') {
             result.push_back(c - '0');
@@ -18,72 +24,131 @@ vector<int> parseKey(const string& keyStr) {
     return result;
 }
 
-//шифрование текста
-string encryptGronsfeld(const string& plaintext, const string& keyStr, bool useCyrillic) {
-    if (plaintext.empty()) return plaintext;
-    
-    vector<int> key = parseKey(keyStr);
+//разбор ключа с проверкой, что в нём есть цифры
+static vector<unsigned char> parseKeyChecked(const string& keyStr) {
+    vector<unsigned char> key = parseKey(keyStr);
     if (key.empty()) {
         throw invalid_argument("Ключ должен содержать хотя бы одну цифру");
     }
-    
-    string ciphertext;
-    size_t keyIndex = 0;
-    
-    for (size_t i = 0; i < plaintext.length(); ) {
-        char currentChar = plaintext[i];
-        int shift = key[keyIndex % key.size()];
-        
-        //обработка кириллицы в UTF-8
-        if (useCyrillic && isCyrillicUTF8(plaintext, i)) {
-            string cyrChar = plaintext.substr(i, 2);
-            
-            //определение регистра
-            bool isUpper;
-            unsigned char first = static_cast<unsigned char>(cyrChar[0]);
-            unsigned char second = static_cast<unsigned char>(cyrChar[1]);
+    return key;
+}
 
-            if (first == 0xD0) {
-                isUpper = (second >= 0x90 && second <= 0xAF);
-            } else {
-                isUpper = false;
-            }
+//скомпилированный ключ: цифры и их периодический шаблон для kernels.h
+struct GronsfeldKey {
+    vector<unsigned char> digits;
+    vector<unsigned char> pattern;
+};
 
-            //корректировка для Ё
-            if (cyrChar == "\xD0\x81") isUpper = true;
-            if (cyrChar == "\xD1\x91") isUpper = false;
-            
-            vector<string> alphabet = getCyrillicAlphabet(isUpper);
-            int alphabetSize = 33;
-            
-            int currentPos = -1;
-            for (size_t j = 0; j < alphabet.size(); j++) {
-                if (alphabet[j] == cyrChar) {
-                    currentPos = j;
-                    break;
-                }
-            }
+static KeyCache<GronsfeldKey> keyCache;
+
+//ключ из кэша; при первом использовании строки он разбирается и проверяется
+static shared_ptr<const GronsfeldKey> compiledKey(const string& keyStr) {
+    return keyCache.get(keyStr, [](const string& text) {
+        GronsfeldKey key;
+        key.digits = parseKeyChecked(text);
+        buildKeyPattern(key.digits.data(), key.digits.size(), key.pattern);
+        return key;
+    });
+}
+
+//участки без кириллицы короче этого обрабатываются скалярно: на них
+//не окупается вызов векторного ядра
+static const size_t TEXT_SIMD_MIN_RUN = 32;
+
+//шифрование/дешифрование текста длины length в буфер out той же длины,
+//keyIndex сохраняется между вызовами. Если flush == false и текст заканчивается
+//первым байтом кириллического символа, он не обрабатывается (ждём второй байт).
+//Участки между кириллическими символами сдвигаются векторно: каждый их байт
+//берёт очередную цифру ключа, как в бинарном режиме.
+//text и out могут совпадать: каждый байт читается до записи на его место.
+//Возвращает число обработанных (и записанных) байт
+static size_t transformGronsfeldText(const char* text, size_t length, const GronsfeldKey& compiled, size_t& keyIndex,
+                                     bool decrypt, bool useCyrillic, bool flush, char* out) {
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(text);
+    unsigned char* output = reinterpret_cast<unsigned char*>(out);
+    const vector<unsigned char>& key = compiled.digits;
+    size_t i = 0;
+    
+    while (i < length) {
+        unsigned char currentChar = input[i];
+        bool isPair = useCyrillic && (currentChar == 0xD0 || currentChar == 0xD1);
+        if (isPair && i + 1 == length) {
+            if (!flush) break;
+            isPair = false;
+        }
+        
+        //обработка кириллицы в UTF-8 по таблице сдвигов
+        if (isPair) {
+            int shift = key[keyIndex % key.size()];
+            const CyrillicLetter* row = cyrillicShiftRow(currentChar, input[i + 1]);
             
-            if (currentPos != -1) {
-                int newPos = (currentPos + shift) % alphabetSize;
-                string encryptedChar = alphabet[newPos];
-                ciphertext += encryptedChar;
+            if (row) {
+                int rotation = decrypt ? (CYRILLIC_ALPHABET_SIZE - shift % CYRILLIC_ALPHABET_SIZE) % CYRILLIC_ALPHABET_SIZE
+                                       : shift % CYRILLIC_ALPHABET_SIZE;
+                output[i] = row[rotation].lead;
+                output[i + 1] = row[rotation].trail;
                 keyIndex++;
             } else {
-                ciphertext += cyrChar;
+                output[i] = input[i];
+                output[i + 1] = input[i + 1];
             }
             
             i += 2;
+            continue;
         }
-        //обработка ВСЕХ остальных символов ASCII
-        else {
-            unsigned char encryptedChar = (static_cast<unsigned char>(currentChar) + shift) % 256;
-            ciphertext += static_cast<char>(encryptedChar);
-            keyIndex++;
-            i++;
+        
+        //обработка ВСЕХ остальных символов ASCII: участок до следующего
+        //кириллического символа, каждый байт сдвигается по модулю 256
+        size_t runEnd = useCyrillic ? i + 1 + findCyrillicLead(input + i + 1, length - i - 1) : length;
+        size_t run = runEnd - i;
+        
+        if (run >= TEXT_SIMD_MIN_RUN) {
+            applyKeyPattern(input + i, output + i, run, compiled.pattern.data(), key.size(), keyIndex % key.size(), decrypt);
+            keyIndex += run;
+            i = runEnd;
+        } else {
+            for (; i < runEnd; i++) {
+                int shift = key[keyIndex % key.size()];
+                output[i] = static_cast<unsigned char>(decrypt ? input[i] - shift : input[i] + shift);
+                keyIndex++;
+            }
         }
     }
     
+    return i;
+}
+
+//настройки параллельной обработки бинарных данных
+static ParallelSettings parallelSettings;
+
+//счётчики вызовов по операциям (CipherMetricOperation)
+static MetricsRegistry callMetrics(CIPHER_METRIC_OPERATIONS);
+
+//бинарная обработка со скомпилированным ключом, offset - позиция первого байта data в потоке.
+//Большие данные делятся на диапазоны со своей начальной фазой ключа
+static void transformGronsfeldBinary(const char* data, size_t length, const GronsfeldKey& key,
+                                     size_t offset, bool decrypt, char* out) {
+    size_t period = key.digits.size();
+    parallelRanges(length, parallelSettings, [&](size_t begin, size_t end) {
+        applyKeyPattern(reinterpret_cast<const unsigned char*>(data + begin), reinterpret_cast<unsigned char*>(out + begin),
+                        end - begin, key.pattern.data(), period, (offset + begin) % period, decrypt);
+    });
+}
+
+//проверка размера буфера вызывающего
+static void checkOutputCapacity(size_t required, size_t outCapacity) {
+    if (outCapacity < required) {
+        throw length_error("Недостаточный размер выходного буфера");
+    }
+}
+
+//шифрование текста
+string encryptGronsfeld(const string& plaintext, const string& keyStr, bool useCyrillic) {
+    if (plaintext.empty()) return plaintext;
+    
+    string ciphertext(plaintext.size(), '\0');
+    encryptGronsfeldInto(plaintext.data(), plaintext.size(), keyStr, &ciphertext[0], ciphertext.size(), useCyrillic);
+    
     return ciphertext;
 }
 
@@ -91,109 +156,282 @@ string encryptGronsfeld(const string& plaintext, const string& keyStr, bool useC
 string decryptGronsfeld(const string& ciphertext, const string& keyStr, bool useCyrillic) {
     if (ciphertext.empty()) return ciphertext;
     
-    vector<int> key = parseKey(keyStr);
-    if (key.empty()) {
-        throw invalid_argument("Ключ должен содержать хотя бы одну цифру");
-    }
-    
-    string plaintext;
-    size_t keyIndex = 0;
-    
-    for (size_t i = 0; i < ciphertext.length(); ) {
-        char currentChar = ciphertext[i];
-        int shift = key[keyIndex % key.size()];
-        
-        //обработка кириллицы в UTF-8
-        if (useCyrillic && isCyrillicUTF8(ciphertext, i)) {
-            string cyrChar = ciphertext.substr(i, 2);
-            
-            //определение регистра
-            bool isUpper;
-            unsigned char first = static_cast<unsigned char>(cyrChar[0]);
-            unsigned char second = static_cast<unsigned char>(cyrChar[1]);
-
-            if (first == 0xD0) {
-                isUpper = (second >= 0x90 && second <= 0xAF);
-            } else {
-                isUpper = false;
-            }
-
-            if (cyrChar == "\xD0\x81") isUpper = true;
-            if (cyrChar == "\xD1\x91") isUpper = false;
-            
-            vector<string> alphabet = getCyrillicAlphabet(isUpper);
-            int alphabetSize = 33;
-            
-            int currentPos = -1;
-            for (size_t j = 0; j < alphabet.size(); j++) {
-                if (alphabet[j] == cyrChar) {
-                    currentPos = j;
-                    break;
-                }
-            }
-            
-            if (currentPos != -1) {
-                int newPos = (currentPos - shift + alphabetSize) % alphabetSize;
-                plaintext += alphabet[newPos];
-                keyIndex++;
-            } else {
-                plaintext += cyrChar;
-            }
-            
-            i += 2;
-        }
-        //обработка остальных символов ASCII
-        else {
-            unsigned char decryptedChar = (static_cast<unsigned char>(currentChar) - shift + 256) % 256;
-            plaintext += static_cast<char>(decryptedChar);
-            keyIndex++;
-            i++;
-        }
-    }
+    string plaintext(ciphertext.size(), '\0');
+    decryptGronsfeldInto(ciphertext.data(), ciphertext.size(), keyStr, &plaintext[0], plaintext.size(), useCyrillic);
     
     return plaintext;
 }
 
 //бинарное шифрование Гронсфельда
 string encryptGronsfeldBinary(const string& data, const string& keyStr) {
+    return encryptGronsfeldBinaryAt(data, keyStr, 0);
+}
+
+//бинарное дешифрование Гронсфельда
+string decryptGronsfeldBinary(const string& data, const string& keyStr) {
+    return decryptGronsfeldBinaryAt(data, keyStr, 0);
+}
+
+//бинарное шифрование Гронсфельда, offset - позиция первого байта data в потоке
+string encryptGronsfeldBinaryAt(const string& data, const string& keyStr, size_t offset) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_ENCRYPT_BINARY, data.size());
     if (data.empty()) return data;
     
-    vector<int> key = parseKey(keyStr);
-    if (key.empty()) {
-        throw invalid_argument("Ключ должен содержать хотя бы одну цифру");
-    }
+    shared_ptr<const GronsfeldKey> key = compiledKey(keyStr);
+    string result(data.size(), '\0');
+    transformGronsfeldBinary(data.data(), data.size(), *key, offset, false, &result[0]);
     
-    string result;
-    size_t keyIndex = 0;
+    return result;
+}
+
+//бинарное дешифрование Гронсфельда, offset - позиция первого байта data в потоке
+string decryptGronsfeldBinaryAt(const string& data, const string& keyStr, size_t offset) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_DECRYPT_BINARY, data.size());
+    if (data.empty()) return data;
     
-    for (size_t i = 0; i < data.length(); ++i) {
-        unsigned char b = static_cast<unsigned char>(data[i]);
-        int shift = key[keyIndex % key.size()];
-        result += static_cast<char>((b + shift) % 256);
-        keyIndex++;
-    }
+    shared_ptr<const GronsfeldKey> key = compiledKey(keyStr);
+    string result(data.size(), '\0');
+    transformGronsfeldBinary(data.data(), data.size(), *key, offset, true, &result[0]);
     
     return result;
 }
 
-//бинарное дешифрование Гронсфельда
-string decryptGronsfeldBinary(const string& data, const string& keyStr) {
-    if (data.empty()) return data;
+//шифрование текста в буфер вызывающего
+size_t encryptGronsfeldInto(const char* data, size_t length, const string& keyStr, char* out, size_t outCapacity, bool useCyrillic) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_ENCRYPT_TEXT, length);
+    if (length == 0) return 0;
     
-    vector<int> key = parseKey(keyStr);
-    if (key.empty()) {
-        throw invalid_argument("Ключ должен содержать хотя бы одну цифру");
-    }
+    shared_ptr<const GronsfeldKey> key = compiledKey(keyStr);
+    checkOutputCapacity(length, outCapacity);
     
-    string result;
     size_t keyIndex = 0;
+    return transformGronsfeldText(data, length, *key, keyIndex, false, useCyrillic, true, out);
+}
+
+//дешифрование текста в буфер вызывающего
+size_t decryptGronsfeldInto(const char* data, size_t length, const string& keyStr, char* out, size_t outCapacity, bool useCyrillic) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_DECRYPT_TEXT, length);
+    if (length == 0) return 0;
+    
+    shared_ptr<const GronsfeldKey> key = compiledKey(keyStr);
+    checkOutputCapacity(length, outCapacity);
+    
+    size_t keyIndex = 0;
+    return transformGronsfeldText(data, length, *key, keyIndex, true, useCyrillic, true, out);
+}
+
+//бинарное шифрование в буфер вызывающего
+size_t encryptGronsfeldBinaryInto(const char* data, size_t length, const string& keyStr, char* out, size_t outCapacity) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_ENCRYPT_BINARY, length);
+    if (length == 0) return 0;
+    
+    shared_ptr<const GronsfeldKey> key = compiledKey(keyStr);
+    checkOutputCapacity(length, outCapacity);
+    
+    transformGronsfeldBinary(data, length, *key, 0, false, out);
+    return length;
+}
+
+//бинарное дешифрование в буфер вызывающего
+size_t decryptGronsfeldBinaryInto(const char* data, size_t length, const string& keyStr, char* out, size_t outCapacity) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_DECRYPT_BINARY, length);
+    if (length == 0) return 0;
+    
+    shared_ptr<const GronsfeldKey> key = compiledKey(keyStr);
+    checkOutputCapacity(length, outCapacity);
+    
+    transformGronsfeldBinary(data, length, *key, 0, true, out);
+    return length;
+}
+
+//шифрование текста на месте
+void encryptGronsfeldInPlace(char* data, size_t length, const string& keyStr, bool useCyrillic) {
+    encryptGronsfeldInto(data, length, keyStr, data, length, useCyrillic);
+}
+
+//дешифрование текста на месте
+void decryptGronsfeldInPlace(char* data, size_t length, const string& keyStr, bool useCyrillic) {
+    decryptGronsfeldInto(data, length, keyStr, data, length, useCyrillic);
+}
+
+//бинарное шифрование на месте, offset - позиция первого байта data в потоке
+void encryptGronsfeldBinaryInPlace(char* data, size_t length, const string& keyStr, size_t offset) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_ENCRYPT_BINARY, length);
+    if (length == 0) return;
+    transformGronsfeldBinary(data, length, *compiledKey(keyStr), offset, false, data);
+}
+
+//бинарное дешифрование на месте, offset - позиция первого байта data в потоке
+void decryptGronsfeldBinaryInPlace(char* data, size_t length, const string& keyStr, size_t offset) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_DECRYPT_BINARY, length);
+    if (length == 0) return;
+    transformGronsfeldBinary(data, length, *compiledKey(keyStr), offset, true, data);
+}
+
+//размер выходного буфера: шифр Гронсфельда сохраняет длину во всех режимах
+size_t gronsfeldOutputSize(size_t inputLength, const string& keyStr, bool decrypt, bool binary) {
+    (void)keyStr;
+    (void)decrypt;
+    (void)binary;
+    return inputLength;
+}
+
+//настройка параллельной обработки
+void setGronsfeldParallelism(unsigned threads, size_t minBytes) {
+    configureParallelism(parallelSettings, threads, minBytes);
+}
+
+//счётчики кэша ключей
+void gronsfeldKeyCacheStats(CipherKeyCacheStats* stats) {
+    if (stats) *stats = keyCache.stats();
+}
+
+//включение счётчиков вызовов
+void setGronsfeldMetricsEnabled(bool enabled) {
+    callMetrics.setEnabled(enabled);
+}
+
+//счётчики вызовов
+void gronsfeldMetrics(CipherMetrics* metrics) {
+    if (metrics) callMetrics.snapshot(metrics);
+}
+
+//контекст пошаговой обработки
+struct GronsfeldContext {
+    shared_ptr<const GronsfeldKey> key;
+    bool decrypt;
+    bool binary;
+    bool useCyrillic;
+    size_t keyIndex;    //номер символа, к которому применяется следующая цифра ключа
+    string pending;     //первый байт кириллического символа с конца предыдущего блока
+};
+
+GronsfeldContext* gronsfeldInit(const string& keyStr, bool decrypt, bool binary, bool useCyrillic) {
+    shared_ptr<const GronsfeldKey> key = compiledKey(keyStr);
     
-    for (size_t i = 0; i < data.length(); ++i) {
-        unsigned char b = static_cast<unsigned char>(data[i]);
-        int shift = key[keyIndex % key.size()];
-        result += static_cast<char>((b - shift + 256) % 256);
-        keyIndex++;
+    GronsfeldContext* ctx = new GronsfeldContext();
+    ctx->key = key;
+    ctx->decrypt = decrypt;
+    ctx->binary = binary;
+    ctx->useCyrillic = useCyrillic;
+    ctx->keyIndex = 0;
+    return ctx;
+}
+
+string gronsfeldUpdate(GronsfeldContext* ctx, const string& data) {
+    ScopedMetric metric(callMetrics, cipherMetricOperation(ctx->decrypt, ctx->binary), data.size());
+    if (ctx->binary) {
+        string result(data.size(), '\0');
+        transformGronsfeldBinary(data.data(), data.size(), *ctx->key, ctx->keyIndex, ctx->decrypt, &result[0]);
+        ctx->keyIndex += data.size();
+        return result;
     }
     
+    //дописываем байт, оставшийся с прошлого вызова
+    const string* input = &data;
+    string joined;
+    if (!ctx->pending.empty()) {
+        joined = ctx->pending + data;
+        input = &joined;
+    }
+    
+    string result(input->size(), '\0');
+    size_t stop = transformGronsfeldText(input->data(), input->size(), *ctx->key, ctx->keyIndex,
+                                         ctx->decrypt, ctx->useCyrillic, false, &result[0]);
+    result.resize(stop);
+    ctx->pending = input->substr(stop);
+    return result;
+}
+
+string gronsfeldFinal(GronsfeldContext* ctx) {
+    string result(ctx->pending.size(), '\0');
+    transformGronsfeldText(ctx->pending.data(), ctx->pending.size(), *ctx->key, ctx->keyIndex,
+                           ctx->decrypt, ctx->useCyrillic, true, &result[0]);
+    delete ctx;
     return result;
-}
\ No newline at end of file
+}
+
+//двоичный интерфейс плагина (cipher_plugin.h)
+
+static size_t gronsfeldBinaryAt(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                                uint64_t offset, uint8_t* out, size_t outCapacity, bool decrypt) {
+    ScopedMetric metric(callMetrics, cipherMetricOperation(decrypt, true), length);
+    if (length == 0) return 0;
+    
+    shared_ptr<const GronsfeldKey> compiled = compiledKey(pluginKey(key, keyLength));
+    checkOutputCapacity(length, outCapacity);
+    
+    transformGronsfeldBinary(reinterpret_cast<const char*>(data), length, *compiled, offset, decrypt,
+                             reinterpret_cast<char*>(out));
+    return length;
+}
+
+static int pluginEncryptBinary(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                               uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    return guardPluginCall(written, [&] {
+        return gronsfeldBinaryAt(data, length, key, keyLength, offset, out, outCapacity, false);
+    });
+}
+
+static int pluginDecryptBinary(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                               uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    return guardPluginCall(written, [&] {
+        return gronsfeldBinaryAt(data, length, key, keyLength, offset, out, outCapacity, true);
+    });
+}
+
+static int pluginEncryptText(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                             uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    if (offset != 0) {
+        return setPluginError(CIPHER_ERROR_UNSUPPORTED, "Текст обрабатывается только целиком");
+    }
+    return guardPluginCall(written, [&] {
+        return encryptGronsfeldInto(reinterpret_cast<const char*>(data), length, pluginKey(key, keyLength),
+                                    reinterpret_cast<char*>(out), outCapacity, true);
+    });
+}
+
+static int pluginDecryptText(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                             uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    if (offset != 0) {
+        return setPluginError(CIPHER_ERROR_UNSUPPORTED, "Текст обрабатывается только целиком");
+    }
+    return guardPluginCall(written, [&] {
+        return decryptGronsfeldInto(reinterpret_cast<const char*>(data), length, pluginKey(key, keyLength),
+                                    reinterpret_cast<char*>(out), outCapacity, true);
+    });
+}
+
+static void pluginSetMetricsEnabled(int enabled) {
+    callMetrics.setEnabled(enabled != 0);
+}
+
+static size_t pluginOutputSize(size_t length, const uint8_t* key, size_t keyLength, int decrypt, int binary) {
+    (void)key;
+    (void)keyLength;
+    (void)decrypt;
+    (void)binary;
+    return length;
+}
+
+const CipherPluginDescriptor* gronsfeldPluginDescriptor() {
+    static const CipherPluginDescriptor descriptor = {
+        CIPHER_PLUGIN_ABI_VERSION,
+        sizeof(CipherPluginDescriptor),
+        "gronsfeld",
+        CIPHER_CAP_STREAMING | CIPHER_CAP_IN_PLACE_BINARY | CIPHER_CAP_IN_PLACE_TEXT | CIPHER_CAP_PARALLEL_SAFE,
+        pluginSimdLevel(),
+        CIPHER_SIZE_SAME,
+        pluginOutputSize,
+        pluginEncryptBinary,
+        pluginDecryptBinary,
+        pluginEncryptText,
+        pluginDecryptText,
+        setGronsfeldParallelism,
+        pluginLastError,
+        gronsfeldKeyCacheStats,
+        pluginSetMetricsEnabled,
+        gronsfeldMetrics
+    };
+    return &descriptor;
+}
@@ -2,6 +2,7 @@
 #define CIPHER_GRONSFELD_H
 
 #include <string>
+#include "cipher_plugin.h"
 using namespace std;
 
 #ifdef __cplusplus
@@ -20,6 +21,80 @@ string encryptGronsfeldBinary(const string& data, const string& key);
 __attribute__((visibility("default")))
 string decryptGronsfeldBinary(const string& data, const string& key);
 
+//бинарные функции с начальной позицией в потоке (для обработки по частям)
+__attribute__((visibility("default")))
+string encryptGronsfeldBinaryAt(const string& data, const string& key, size_t offset);
+
+__attribute__((visibility("default")))
+string decryptGronsfeldBinaryAt(const string& data, const string& key, size_t offset);
+
+//варианты с буфером вызывающего: результат пишется в out ёмкостью outCapacity,
+//возвращается число записанных байт (length_error, если буфер мал)
+__attribute__((visibility("default")))
+size_t encryptGronsfeldInto(const char* data, size_t length, const string& keyStr, char* out, size_t outCapacity, bool useCyrillic = true);
+
+__attribute__((visibility("default")))
+size_t decryptGronsfeldInto(const char* data, size_t length, const string& keyStr, char* out, size_t outCapacity, bool useCyrillic = true);
+
+__attribute__((visibility("default")))
+size_t encryptGronsfeldBinaryInto(const char* data, size_t length, const string& keyStr, char* out, size_t outCapacity);
+
+__attribute__((visibility("default")))
+size_t decryptGronsfeldBinaryInto(const char* data, size_t length, const string& keyStr, char* out, size_t outCapacity);
+
+//преобразование на месте: шифр сохраняет длину, поэтому результат пишется
+//поверх data без второго буфера. offset - позиция data в бинарном потоке
+__attribute__((visibility("default")))
+void encryptGronsfeldInPlace(char* data, size_t length, const string& keyStr, bool useCyrillic = true);
+
+__attribute__((visibility("default")))
+void decryptGronsfeldInPlace(char* data, size_t length, const string& keyStr, bool useCyrillic = true);
+
+__attribute__((visibility("default")))
+void encryptGronsfeldBinaryInPlace(char* data, size_t length, const string& keyStr, size_t offset = 0);
+
+__attribute__((visibility("default")))
+void decryptGronsfeldBinaryInPlace(char* data, size_t length, const string& keyStr, size_t offset = 0);
+
+//размер выходного буфера, достаточный для результата в данном режиме
+__attribute__((visibility("default")))
+size_t gronsfeldOutputSize(size_t inputLength, const string& keyStr, bool decrypt, bool binary);
+
+//параллельная обработка бинарных данных: threads потоков (0 - по числу ядер),
+//данные меньше minBytes на поток обрабатываются в одном потоке
+__attribute__((visibility("default")))
+void setGronsfeldParallelism(unsigned threads, size_t minBytes);
+
+//счётчики кэша скомпилированных ключей: повторные вызовы с тем же ключом
+//не разбирают его заново
+__attribute__((visibility("default")))
+void gronsfeldKeyCacheStats(CipherKeyCacheStats* stats);
+
+//счётчики вызовов: число, объём данных, время и гистограмма задержек по
+//операциям. Сбор по умолчанию выключен
+__attribute__((visibility("default")))
+void setGronsfeldMetricsEnabled(bool enabled);
+
+__attribute__((visibility("default")))
+void gronsfeldMetrics(CipherMetrics* metrics);
+
+//пошаговая обработка: ключ разбирается один раз в init, позиция ключа
+//сохраняется между вызовами update, final выдаёт остаток и освобождает контекст
+struct GronsfeldContext;
+
+__attribute__((visibility("default")))
+GronsfeldContext* gronsfeldInit(const string& keyStr, bool decrypt, bool binary, bool useCyrillic = true);
+
+__attribute__((visibility("default")))
+string gronsfeldUpdate(GronsfeldContext* ctx, const string& data);
+
+__attribute__((visibility("default")))
+string gronsfeldFinal(GronsfeldContext* ctx);
+
+//описание библиотеки для двоичного интерфейса плагинов (cipher_plugin.h)
+__attribute__((visibility("default")))
+const CipherPluginDescriptor* gronsfeldPluginDescriptor();
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,289 @@
+#include "kernels.h"
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#endif
+
+using namespace std;
+
+//скалярная версия, используется для хвостов и на процессорах без SIMD
+static void applyKeyStreamScalar(const unsigned char* in, unsigned char* out, size_t length,
+                                 const unsigned char* pattern, size_t keyLen, size_t phase, bool subtract) {
+    size_t k = phase;
+    if (subtract) {
+        for (size_t i = 0; i < length; ++i) {
+            out[i] = static_cast<unsigned char>(in[i] - pattern[k]);
+            if (++k == keyLen) k = 0;
+        }
+    } else {
+        for (size_t i = 0; i < length; ++i) {
+            out[i] = static_cast<unsigned char>(in[i] + pattern[k]);
+            if (++k == keyLen) k = 0;
+        }
+    }
+}
+
+//скалярный сдвиг латинских букв и остальных байтов (см. applyLatinShift)
+static void applyLatinShiftScalar(const unsigned char* in, unsigned char* out, size_t length,
+                                  const unsigned char* letterPattern, const unsigned char* otherPattern,
+                                  size_t period, size_t phase) {
+    size_t k = phase;
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = in[i];
+        int base = (c >= 'A' && c <= 'Z') ? 'A' : (c >= 'a' && c <= 'z') ? 'a' : 0;
+        if (base) {
+            int d = c - base + static_cast<signed char>(letterPattern[k]);
+            if (d > 25) d -= 26;
+            out[i] = static_cast<unsigned char>(base + d);
+        } else {
+            out[i] = static_cast<unsigned char>(c + otherPattern[k]);
+        }
+        if (++k == period) k = 0;
+    }
+}
+
+static size_t findCyrillicLeadScalar(const unsigned char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if ((data[i] & 0xFE) == 0xD0) return i;
+    }
+    return length;
+}
+
+#ifdef KERNELS_X86
+//SSE2: 16 байт за инструкцию. pattern содержит ключ, повторённый так,
+//что с любой позиции k < keyLen можно прочитать KEY_PATTERN_TAIL байт подряд
+static size_t applyKeyStreamSSE2(const unsigned char* in, unsigned char* out, size_t length,
+                                 const unsigned char* pattern, size_t keyLen, size_t& phase, bool subtract) {
+    const size_t width = 16;
+    size_t step = width % keyLen;
+    size_t k = phase;
+    size_t i = 0;
+    
+    for (; i + width <= length; i += width) {
+        __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i keys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern + k));
+        __m128i res = subtract ? _mm_sub_epi8(data, keys) : _mm_add_epi8(data, keys);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), res);
+        k += step;
+        if (k >= keyLen) k -= keyLen;
+    }
+    
+    phase = k;
+    return i;
+}
+
+//AVX2: 32 байта за инструкцию
+__attribute__((target("avx2")))
+static size_t applyKeyStreamAVX2(const unsigned char* in, unsigned char* out, size_t length,
+                                 const unsigned char* pattern, size_t keyLen, size_t& phase, bool subtract) {
+    const size_t width = 32;
+    size_t step = width % keyLen;
+    size_t k = phase;
+    size_t i = 0;
+    
+    for (; i + width <= length; i += width) {
+        __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i keys = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern + k));
+        __m256i res = subtract ? _mm256_sub_epi8(data, keys) : _mm256_add_epi8(data, keys);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), res);
+        k += step;
+        if (k >= keyLen) k -= keyLen;
+    }
+    
+    phase = k;
+    return i;
+}
+
+//SSE2: поиск начала кириллического символа по 16 байт
+static size_t findCyrillicLeadSSE2(const unsigned char* data, size_t length) {
+    const __m128i mask = _mm_set1_epi8(static_cast<char>(0xFE));
+    const __m128i lead = _mm_set1_epi8(static_cast<char>(0xD0));
+    size_t i = 0;
+    
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int found = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(bytes, mask), lead));
+        if (found) return i + __builtin_ctz(found);
+    }
+    
+    return i + findCyrillicLeadScalar(data + i, length - i);
+}
+
+//AVX2: то же по 32 байта
+__attribute__((target("avx2")))
+static size_t findCyrillicLeadAVX2(const unsigned char* data, size_t length) {
+    const __m256i mask = _mm256_set1_epi8(static_cast<char>(0xFE));
+    const __m256i lead = _mm256_set1_epi8(static_cast<char>(0xD0));
+    size_t i = 0;
+    
+    for (; i + 32 <= length; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        unsigned found = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(bytes, mask), lead)));
+        if (found) return i + __builtin_ctz(found);
+    }
+    
+    return i + findCyrillicLeadSSE2(data + i, length - i);
+}
+
+//SSE2: сдвиг латинских букв по 16 байт. Буквы выделяются знаковыми
+//сравнениями (байты >= 0x80 отрицательны и в диапазоны не попадают),
+//d = c - base + shift лежит в [-26, 51], поэтому одного вычитания 26 достаточно
+static size_t applyLatinShiftSSE2(const unsigned char* in, unsigned char* out, size_t length,
+                                  const unsigned char* letterPattern, const unsigned char* otherPattern,
+                                  size_t period, size_t& phase) {
+    const size_t width = 16;
+    const __m128i upperLow = _mm_set1_epi8('A' - 1), upperHigh = _mm_set1_epi8('Z' + 1);
+    const __m128i lowerLow = _mm_set1_epi8('a' - 1), lowerHigh = _mm_set1_epi8('z' + 1);
+    const __m128i upperBase = _mm_set1_epi8('A'), lowerBase = _mm_set1_epi8('a');
+    const __m128i last = _mm_set1_epi8(25), alphabet = _mm_set1_epi8(26);
+    size_t step = width % period;
+    size_t k = phase;
+    size_t i = 0;
+    
+    for (; i + width <= length; i += width) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i letterShift = _mm_loadu_si128(reinterpret_cast<const __m128i*>(letterPattern + k));
+        __m128i otherShift = _mm_loadu_si128(reinterpret_cast<const __m128i*>(otherPattern + k));
+        
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, upperLow), _mm_cmpgt_epi8(upperHigh, c));
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, lowerLow), _mm_cmpgt_epi8(lowerHigh, c));
+        __m128i letter = _mm_or_si128(upper, lower);
+        __m128i base = _mm_or_si128(_mm_and_si128(upper, upperBase), _mm_andnot_si128(upper, lowerBase));
+        
+        __m128i d = _mm_add_epi8(_mm_sub_epi8(c, base), letterShift);
+        d = _mm_sub_epi8(d, _mm_and_si128(_mm_cmpgt_epi8(d, last), alphabet));
+        __m128i shifted = _mm_add_epi8(base, d);
+        __m128i other = _mm_add_epi8(c, otherShift);
+        
+        __m128i res = _mm_or_si128(_mm_and_si128(letter, shifted), _mm_andnot_si128(letter, other));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), res);
+        k += step;
+        if (k >= period) k -= period;
+    }
+    
+    phase = k;
+    return i;
+}
+
+//AVX2: то же по 32 байта
+__attribute__((target("avx2")))
+static size_t applyLatinShiftAVX2(const unsigned char* in, unsigned char* out, size_t length,
+                                  const unsigned char* letterPattern, const unsigned char* otherPattern,
+                                  size_t period, size_t& phase) {
+    const size_t width = 32;
+    const __m256i upperLow = _mm256_set1_epi8('A' - 1), upperHigh = _mm256_set1_epi8('Z' + 1);
+    const __m256i lowerLow = _mm256_set1_epi8('a' - 1), lowerHigh = _mm256_set1_epi8('z' + 1);
+    const __m256i upperBase = _mm256_set1_epi8('A'), lowerBase = _mm256_set1_epi8('a');
+    const __m256i last = _mm256_set1_epi8(25), alphabet = _mm256_set1_epi8(26);
+    size_t step = width % period;
+    size_t k = phase;
+    size_t i = 0;
+    
+    for (; i + width <= length; i += width) {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i letterShift = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(letterPattern + k));
+        __m256i otherShift = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(otherPattern + k));
+        
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, upperLow), _mm256_cmpgt_epi8(upperHigh, c));
+        __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(c, lowerLow), _mm256_cmpgt_epi8(lowerHigh, c));
+        __m256i letter = _mm256_or_si256(upper, lower);
+        __m256i base = _mm256_blendv_epi8(lowerBase, upperBase, upper);
+        
+        __m256i d = _mm256_add_epi8(_mm256_sub_epi8(c, base), letterShift);
+        d = _mm256_sub_epi8(d, _mm256_and_si256(_mm256_cmpgt_epi8(d, last), alphabet));
+        __m256i shifted = _mm256_add_epi8(base, d);
+        __m256i other = _mm256_add_epi8(c, otherShift);
+        
+        __m256i res = _mm256_blendv_epi8(other, shifted, letter);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), res);
+        k += step;
+        if (k >= period) k -= period;
+    }
+    
+    phase = k;
+    return i;
+}
+#endif
+
+SimdLevel detectSimdLevel() {
+#ifdef KERNELS_X86
+    static const SimdLevel level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+        return SimdLevel::SCALAR;
+    }();
+    return level;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+void buildKeyPattern(const unsigned char* key, size_t keyLen, vector<unsigned char>& pattern) {
+    pattern.resize(keyLen + KEY_PATTERN_TAIL);
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        pattern[i] = keyLen ? key[i % keyLen] : 0;
+    }
+}
+
+//выполнение шаблона на лучшем доступном уровне, хвост - скалярно
+void applyKeyPattern(const unsigned char* in, unsigned char* out, size_t length,
+                     const unsigned char* pattern, size_t keyLen, size_t phase, bool subtract) {
+    if (length == 0 || keyLen == 0) return;
+    phase %= keyLen;
+    
+    size_t done = 0;
+#ifdef KERNELS_X86
+    switch (detectSimdLevel()) {
+        case SimdLevel::AVX2:
+            done = applyKeyStreamAVX2(in, out, length, pattern, keyLen, phase, subtract);
+            break;
+        case SimdLevel::SSE2:
+            done = applyKeyStreamSSE2(in, out, length, pattern, keyLen, phase, subtract);
+            break;
+        default:
+            break;
+    }
+#endif
+    
+    applyKeyStreamScalar(in + done, out + done, length - done, pattern, keyLen, phase, subtract);
+}
+
+size_t findCyrillicLead(const unsigned char* data, size_t length) {
+#ifdef KERNELS_X86
+    switch (detectSimdLevel()) {
+        case SimdLevel::AVX2:
+            return findCyrillicLeadAVX2(data, length);
+        case SimdLevel::SSE2:
+            return findCyrillicLeadSSE2(data, length);
+        default:
+            break;
+    }
+#endif
+    return findCyrillicLeadScalar(data, length);
+}
+
+void applyLatinShift(const unsigned char* in, unsigned char* out, size_t length,
+                     const unsigned char* letterPattern, const unsigned char* otherPattern,
+                     size_t period, size_t phase) {
+    if (length == 0 || period == 0) return;
+    phase %= period;
+    
+    size_t done = 0;
+#ifdef KERNELS_X86
+    switch (detectSimdLevel()) {
+        case SimdLevel::AVX2:
+            done = applyLatinShiftAVX2(in, out, length, letterPattern, otherPattern, period, phase);
+            break;
+        case SimdLevel::SSE2:
+            done = applyLatinShiftSSE2(in, out, length, letterPattern, otherPattern, period, phase);
+            break;
+        default:
+            break;
+    }
+#endif
+    
+    applyLatinShiftScalar(in + done, out + done, length - done, letterPattern, otherPattern, period, phase);
+}
@@ -0,0 +1,43 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <vector>
+
+//уровни векторизации, доступные на текущем процессоре
+enum class SimdLevel {
+    SCALAR = 0,
+    SSE2 = 1,
+    AVX2 = 2
+};
+
+//определяет лучший доступный уровень (проверяется один раз)
+SimdLevel detectSimdLevel();
+
+//сколько байт шаблона ключа идёт после периода (ширина самого широкого регистра)
+const size_t KEY_PATTERN_TAIL = 32;
+
+//шаблон периодической последовательности для applyKeyPattern: key повторяется
+//до keyLen + KEY_PATTERN_TAIL байт, чтобы с любой фазы читался целый регистр.
+//Строится один раз и используется для многих коротких участков
+void buildKeyPattern(const unsigned char* key, size_t keyLen, std::vector<unsigned char>& pattern);
+
+//побайтовое сложение (или вычитание) данных с периодическим ключом по модулю 256
+//по готовому шаблону: out[i] = in[i] +/- key[(phase + i) % keyLen].
+//in и out могут совпадать
+void applyKeyPattern(const unsigned char* in, unsigned char* out, size_t length,
+                     const unsigned char* pattern, size_t keyLen, size_t phase, bool subtract);
+
+//позиция первого байта 0xD0/0xD1 (начала кириллического символа UTF-8) или length
+size_t findCyrillicLead(const unsigned char* data, size_t length);
+
+//сдвиг по периодическим шаблонам длины period с фазы phase: латинские буквы
+//циклически сдвигаются на letterShift (знаковый байт, от -26 до 26) внутри
+//своего регистра, остальные байты складываются с otherShift по модулю 256.
+//Результат буквы, ушедший ниже 'A'/'a', не заворачивается (как в скалярном
+//коде Виженера). in и out могут совпадать
+void applyLatinShift(const unsigned char* in, unsigned char* out, size_t length,
+                     const unsigned char* letterPattern, const unsigned char* otherPattern,
+                     size_t period, size_t phase);
+
+#endif
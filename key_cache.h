@@ -0,0 +1,98 @@
+#ifndef KEY_CACHE_H
+#define KEY_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "cipher_plugin.h"
+
+using namespace std;
+
+//число скомпилированных ключей, хранимых шифром
+const size_t DEFAULT_KEY_CACHE_CAPACITY = 64;
+
+//ключи длиннее этого не кэшируются: их разбор и так дорог относительно
+//размера, а хранение расписаний для них занимало бы много памяти
+const size_t MAX_CACHED_KEY_LENGTH = 4096;
+
+//потокобезопасный кэш скомпилированных ключей с вытеснением давно
+//не использованных (LRU). Значения отдаются через shared_ptr, поэтому
+//вытеснение не мешает вызовам, которые ещё работают со старым расписанием
+template <typename Value>
+class KeyCache {
+public:
+    explicit KeyCache(size_t capacity = DEFAULT_KEY_CACHE_CAPACITY) : capacity(capacity), hits(0), misses(0) {}
+    
+    KeyCache(const KeyCache&) = delete;
+    KeyCache& operator=(const KeyCache&) = delete;
+    
+    //скомпилированный ключ для key; при промахе вызывается compile(key),
+    //возвращающий Value. Компиляция идёт без блокировки, исключения из
+    //compile передаются вызывающему, и в кэш ничего не попадает
+    template <typename Compile>
+    shared_ptr<const Value> get(const string& key, Compile compile) {
+        if (key.size() > MAX_CACHED_KEY_LENGTH || capacity == 0) {
+            lock_guard<mutex> lock(guard);
+            misses++;
+            return make_shared<const Value>(compile(key));
+        }
+        
+        {
+            lock_guard<mutex> lock(guard);
+            auto found = index.find(key);
+            if (found != index.end()) {
+                hits++;
+                entries.splice(entries.begin(), entries, found->second);
+                return found->second->second;
+            }
+            misses++;
+        }
+        
+        shared_ptr<const Value> value = make_shared<const Value>(compile(key));
+        
+        lock_guard<mutex> lock(guard);
+        //другой поток мог успеть добавить тот же ключ
+        auto found = index.find(key);
+        if (found != index.end()) {
+            entries.splice(entries.begin(), entries, found->second);
+            return found->second->second;
+        }
+        
+        entries.emplace_front(key, value);
+        index[key] = entries.begin();
+        while (entries.size() > capacity) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+        return value;
+    }
+    
+    //счётчики в терминах интерфейса плагинов
+    CipherKeyCacheStats stats() const {
+        lock_guard<mutex> lock(guard);
+        CipherKeyCacheStats result;
+        result.hits = hits;
+        result.misses = misses;
+        result.entries = entries.size();
+        result.capacity = capacity;
+        return result;
+    }
+
+private:
+    typedef list<pair<string, shared_ptr<const Value>>> EntryList;
+    
+    mutable mutex guard;
+    size_t capacity;
+    EntryList entries;                                      //от недавних к давним
+    unordered_map<string, typename EntryList::iterator> index;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+#endif
@@ -4,9 +4,35 @@
 #include <fstream>
 #include <limits>
 #include <vector>
-#include <dlfcn.h>
+#include <algorithm>
+#include <getopt.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <functional>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
 
 #include "utils.h"
+#include "mapped_file.h"
+#include "file_pipeline.h"
+#include "batch_io.h"
+#include "container.h"
+#include "metrics.h"
+#include "program_metrics.h"
+#include "cipher_plugin.h"
+
+//CIPHER_STATIC_BUILD - шифры компонуются в программу вместо загрузки библиотек
+#ifdef CIPHER_STATIC_BUILD
+#include "permutation.h"
+#include "vigenere.h"
+#include "gronsfeld.h"
+#else
+#include <dlfcn.h>
+#endif
 
 using namespace std;
 
@@ -37,72 +63,229 @@ struct CipherFunctions {
     string (*decryptText)(const string&, const string&, bool);
     string (*encryptBinary)(const string&, const string&);
     string (*decryptBinary)(const string&, const string&);
+    //настройка параллельной обработки бинарных данных
+    void (*setParallelism)(unsigned, size_t);
+    //пошаговая обработка (init/update/final)
+    void* (*contextInit)(const string&, bool, bool, bool);
+    string (*contextUpdate)(void*, const string&);
+    string (*contextFinal)(void*);
+    //описание буферного интерфейса (nullptr - библиотека его не поддерживает)
+    const CipherPluginDescriptor* descriptor;
     void* libraryHandle;
     
-    CipherFunctions() : encryptText(nullptr), decryptText(nullptr), encryptBinary(nullptr), decryptBinary(nullptr), libraryHandle(nullptr) {}
+    CipherFunctions() : encryptText(nullptr), decryptText(nullptr), encryptBinary(nullptr), decryptBinary(nullptr),
+                        setParallelism(nullptr), contextInit(nullptr),
+                        contextUpdate(nullptr), contextFinal(nullptr), descriptor(nullptr), libraryHandle(nullptr) {}
 };
 
-//функция для загрузки библиотеки
-CipherFunctions loadCipherLibrary(CipherMethod method) {
+//обрабатывать бинарные файлы через отображение в память, когда это возможно
+bool useMappedFiles = true;
+
+//совмещать чтение, шифрование и запись при потоковой обработке файлов
+bool usePipeline = true;
+
+//обрабатывать пакет файлов через io_uring (если ядро его поддерживает).
+//Выключено по умолчанию: открытие файлов с созданием и буферизованную
+//запись ядро выполняет в своих рабочих потоках, и на машинах с одним-двумя
+//ядрами это медленнее обработки файлов по одному через отображение в память
+bool useUring = false;
+
+//формат отчёта о счётчиках при завершении (--stats)
+enum class StatsFormat {
+    NONE,
+    TEXT,
+    JSON
+};
+
+StatsFormat statsFormat = StatsFormat::NONE;
+
+//бинарные данные в формате контейнера: заголовок, независимо зашифрованные
+//блоки и индекс блоков (--container)
+bool useContainer = false;
+size_t containerChunkSize = CONTAINER_DEFAULT_CHUNK_SIZE;
+
+//число потоков для бинарных шифров (0 - по числу ядер) и минимальный объём на поток
+unsigned cipherThreads = 0;
+size_t parallelMinBytes = 256 * 1024;
+
+//размер блока при потоковой обработке файлов
+const size_t STREAM_CHUNK_SIZE = 1 << 20;
+
+//размер окна при обработке отображённого файла на месте: достаточно велик,
+//чтобы шифр мог распределить окно по потокам
+const size_t MAPPED_WINDOW_SIZE = 16 << 20;
+
+//количество шифров (значения CipherMethod идут подряд, начиная с 1)
+const int CIPHER_COUNT = 3;
+
+//реестр шифров: каждая библиотека загружается один раз за время работы программы
+struct CipherRegistry {
+    CipherFunctions ciphers[CIPHER_COUNT];
+    //причина, по которой библиотека не загрузилась (пусто, если загружена)
+    string loadErrors[CIPHER_COUNT];
+};
+
+#ifdef CIPHER_STATIC_BUILD
+//функции шифров скомпонованы в программу: таблица заполняется адресами,
+//известными при компоновке, без dlopen/dlsym и вызовов через PLT.
+//Перестановка и контексты приводятся к общим сигнатурам таблицы
+CipherFunctions linkedCipherFunctions(CipherMethod method, string& error) {
     CipherFunctions funcs;
-    const char* libraryName = nullptr;
     
     switch (method) {
         case CipherMethod::PERMUTATION:
-            libraryName = "./libpermutation.so";
+            funcs.encryptText = [](const string& text, const string& key, bool) { return encryptPermutationText(text, key); };
+            funcs.decryptText = [](const string& text, const string& key, bool) { return decryptPermutationText(text, key); };
+            funcs.encryptBinary = encryptPermutationBinary;
+            funcs.decryptBinary = decryptPermutationBinary;
+            funcs.setParallelism = setPermutationParallelism;
+            funcs.contextInit = [](const string& key, bool decrypt, bool binary, bool) -> void* {
+                return permutationInit(key, decrypt, binary);
+            };
+            funcs.contextUpdate = [](void* ctx, const string& data) {
+                return permutationUpdate(static_cast<PermutationContext*>(ctx), data);
+            };
+            funcs.contextFinal = [](void* ctx) { return permutationFinal(static_cast<PermutationContext*>(ctx)); };
+            funcs.descriptor = permutationPluginDescriptor();
             break;
         case CipherMethod::VIGENERE:
-            libraryName = "./libvigenere.so";
+            funcs.encryptText = encryptVigenere;
+            funcs.decryptText = decryptVigenere;
+            funcs.encryptBinary = encryptVigenereBinary;
+            funcs.decryptBinary = decryptVigenereBinary;
+            funcs.setParallelism = setVigenereParallelism;
+            funcs.contextInit = [](const string& key, bool decrypt, bool binary, bool useCyrillic) -> void* {
+                return vigenereInit(key, decrypt, binary, useCyrillic);
+            };
+            funcs.contextUpdate = [](void* ctx, const string& data) {
+                return vigenereUpdate(static_cast<VigenereContext*>(ctx), data);
+            };
+            funcs.contextFinal = [](void* ctx) { return vigenereFinal(static_cast<VigenereContext*>(ctx)); };
+            funcs.descriptor = vigenerePluginDescriptor();
             break;
         case CipherMethod::GRONSFELD:
-            libraryName = "./libgronsfeld.so";
+            funcs.encryptText = encryptGronsfeld;
+            funcs.decryptText = decryptGronsfeld;
+            funcs.encryptBinary = encryptGronsfeldBinary;
+            funcs.decryptBinary = decryptGronsfeldBinary;
+            funcs.setParallelism = setGronsfeldParallelism;
+            funcs.contextInit = [](const string& key, bool decrypt, bool binary, bool useCyrillic) -> void* {
+                return gronsfeldInit(key, decrypt, binary, useCyrillic);
+            };
+            funcs.contextUpdate = [](void* ctx, const string& data) {
+                return gronsfeldUpdate(static_cast<GronsfeldContext*>(ctx), data);
+            };
+            funcs.contextFinal = [](void* ctx) { return gronsfeldFinal(static_cast<GronsfeldContext*>(ctx)); };
+            funcs.descriptor = gronsfeldPluginDescriptor();
             break;
         default:
-            cout << "Неизвестный метод шифрования" << endl;
+            error = "Неизвестный метод шифрования";
             return funcs;
     }
     
-    if (!libraryName) {
+    funcs.setParallelism(cipherThreads, parallelMinBytes);
+    return funcs;
+}
+#else
+//имена библиотеки шифра и её экспортируемых функций
+struct CipherLibraryInfo {
+    const char* libraryName;
+    const char* encryptText;
+    const char* decryptText;
+    const char* encryptBinary;
+    const char* decryptBinary;
+    //необязательные функции (nullptr - шифр их не поддерживает)
+    const char* setParallelism;
+    const char* contextInit;
+    const char* contextUpdate;
+    const char* contextFinal;
+    const char* descriptor;
+};
+
+//описание библиотек в порядке значений CipherMethod
+const CipherLibraryInfo CIPHER_LIBRARIES[CIPHER_COUNT] = {
+    {"./libpermutation.so",
+     "encryptPermutationText", "decryptPermutationText", "encryptPermutationBinary", "decryptPermutationBinary",
+     "setPermutationParallelism", "permutationInit", "permutationUpdate", "permutationFinal",
+     "permutationPluginDescriptor"},
+    {"./libvigenere.so",
+     "encryptVigenere", "decryptVigenere", "encryptVigenereBinary", "decryptVigenereBinary",
+     "setVigenereParallelism", "vigenereInit", "vigenereUpdate", "vigenereFinal",
+     "vigenerePluginDescriptor"},
+    {"./libgronsfeld.so",
+     "encryptGronsfeld", "decryptGronsfeld", "encryptGronsfeldBinary", "decryptGronsfeldBinary",
+     "setGronsfeldParallelism", "gronsfeldInit", "gronsfeldUpdate", "gronsfeldFinal",
+     "gronsfeldPluginDescriptor"}
+};
+
+//поиск функции в библиотеке; для необязательных функций имя может отсутствовать
+template <typename Function>
+void resolveSymbol(void* handle, const char* name, Function& target) {
+    target = name ? reinterpret_cast<Function>(dlsym(handle, name)) : nullptr;
+}
+
+//функция для загрузки библиотеки
+CipherFunctions loadCipherLibrary(CipherMethod method, string& error) {
+    CipherFunctions funcs;
+    int index = static_cast<int>(method) - 1;
+    if (index < 0 || index >= CIPHER_COUNT) {
+        error = "Неизвестный метод шифрования";
         return funcs;
     }
+    const CipherLibraryInfo& info = CIPHER_LIBRARIES[index];
     
-    void* handle = dlopen(libraryName, RTLD_LAZY);
+    //все символы разрешаем сразу, чтобы повреждённая библиотека обнаружилась при загрузке,
+    //а не при первом вызове шифра
+    void* handle;
+    {
+        ScopedMetric metric(programMetrics(), PROGRAM_METRIC_LOAD_LIBRARY, 0);
+        handle = dlopen(info.libraryName, RTLD_NOW);
+    }
     if (!handle) {
-        cout << "Ошибка загрузки библиотеки " << libraryName << ": " << dlerror() << endl;
-        cout << "Текущая директория: " << get_current_dir_name() << endl;
+        error = string("Ошибка загрузки библиотеки ") + info.libraryName + ": " + dlerror() +
+                "\nТекущая директория: " + get_current_dir_name();
         return funcs;
     }
     
     funcs.libraryHandle = handle;
     
     //загружаем функции
-    switch (method) {
-        case CipherMethod::PERMUTATION:
-            funcs.encryptText = reinterpret_cast<string(*)(const string&, const string&, bool)>(dlsym(handle, "encryptPermutationText"));
-            funcs.decryptText = reinterpret_cast<string(*)(const string&, const string&, bool)>(dlsym(handle, "decryptPermutationText"));
-            funcs.encryptBinary = reinterpret_cast<string(*)(const string&, const string&)>(dlsym(handle, "encryptPermutationBinary"));
-            funcs.decryptBinary = reinterpret_cast<string(*)(const string&, const string&)>(dlsym(handle, "decryptPermutationBinary"));
-            break;
-        case CipherMethod::VIGENERE:
-            funcs.encryptText = reinterpret_cast<string(*)(const string&, const string&, bool)>(dlsym(handle, "encryptVigenere"));
-            funcs.decryptText = reinterpret_cast<string(*)(const string&, const string&, bool)>(dlsym(handle, "decryptVigenere"));
-            funcs.encryptBinary = reinterpret_cast<string(*)(const string&, const string&)>(dlsym(handle, "encryptVigenereBinary"));
-            funcs.decryptBinary = reinterpret_cast<string(*)(const string&, const string&)>(dlsym(handle, "decryptVigenereBinary"));
-            break;
-        case CipherMethod::GRONSFELD:
-            funcs.encryptText = reinterpret_cast<string(*)(const string&, const string&, bool)>(dlsym(handle, "encryptGronsfeld"));
-            funcs.decryptText = reinterpret_cast<string(*)(const string&, const string&, bool)>(dlsym(handle, "decryptGronsfeld"));
-            funcs.encryptBinary = reinterpret_cast<string(*)(const string&, const string&)>(dlsym(handle, "encryptGronsfeldBinary"));
-            funcs.decryptBinary = reinterpret_cast<string(*)(const string&, const string&)>(dlsym(handle, "decryptGronsfeldBinary"));
-            break;
-    }
+    dlerror();
+    resolveSymbol(handle, info.encryptText, funcs.encryptText);
+    resolveSymbol(handle, info.decryptText, funcs.decryptText);
+    resolveSymbol(handle, info.encryptBinary, funcs.encryptBinary);
+    resolveSymbol(handle, info.decryptBinary, funcs.decryptBinary);
     
     //проверяем ошибки загрузки функций
     const char* dlsym_error = dlerror();
     if (dlsym_error) {
-        cout << "Ошибка загрузки функций из библиотеки " << libraryName << ": " << dlsym_error << endl;
+        error = string("Ошибка загрузки функций из библиотеки ") + info.libraryName + ": " + dlsym_error;
         dlclose(handle);
         funcs = CipherFunctions();
+        return funcs;
+    }
+    
+    //необязательные функции: настройка потоков и пошаговая обработка
+    resolveSymbol(handle, info.setParallelism, funcs.setParallelism);
+    resolveSymbol(handle, info.contextInit, funcs.contextInit);
+    resolveSymbol(handle, info.contextUpdate, funcs.contextUpdate);
+    resolveSymbol(handle, info.contextFinal, funcs.contextFinal);
+    
+    //описание принимаем только от библиотеки, собранной с совместимой версией
+    //интерфейса; поля, добавленные позже, у старой библиотеки могут отсутствовать
+    CipherPluginEntry descriptorEntry;
+    resolveSymbol(handle, info.descriptor, descriptorEntry);
+    if (descriptorEntry) {
+        const CipherPluginDescriptor* descriptor = descriptorEntry();
+        if (descriptor && descriptor->abiVersion == CIPHER_PLUGIN_ABI_VERSION &&
+            descriptor->structSize >= CIPHER_PLUGIN_BASE_SIZE) {
+            funcs.descriptor = descriptor;
+        }
+    }
+    dlerror();
+    
+    if (funcs.setParallelism) {
+        funcs.setParallelism(cipherThreads, parallelMinBytes);
     }
     
     return funcs;
@@ -112,131 +295,505 @@ CipherFunctions loadCipherLibrary(CipherMethod method) {
 void unloadCipherLibrary(CipherFunctions& funcs) {
     if (funcs.libraryHandle) {
         dlclose(funcs.libraryHandle);
-        funcs.libraryHandle = nullptr;
     }
-    funcs.encryptText = nullptr;
-    funcs.decryptText = nullptr;
-    funcs.encryptBinary = nullptr;
-    funcs.decryptBinary = nullptr;
+    funcs = CipherFunctions();
 }
 
-//функции для работы с текстовыми файлами
-void encryptTextFile(const string& inputFile, const string& outputFile, const string& key, 
-                    CipherFunctions& cipherFuncs) {
-    ifstream in(inputFile);
-    ofstream out(outputFile);
-    if (!in) throw runtime_error("Не удалось открыть файл " + inputFile);
-    if (!out) throw runtime_error("Не удалось создать файл " + outputFile);
+#endif
 
-    if (!cipherFuncs.encryptText) {
-        throw runtime_error("Шифр недоступен");
+//загрузка всех библиотек шифров при старте программы
+void loadCipherRegistry(CipherRegistry& registry) {
+    for (int i = 0; i < CIPHER_COUNT; i++) {
+        registry.loadErrors[i].clear();
+#ifdef CIPHER_STATIC_BUILD
+        registry.ciphers[i] = linkedCipherFunctions(static_cast<CipherMethod>(i + 1), registry.loadErrors[i]);
+#else
+        registry.ciphers[i] = loadCipherLibrary(static_cast<CipherMethod>(i + 1), registry.loadErrors[i]);
+#endif
     }
+}
 
-    string text;
-    string line;
-    while (getline(in, line)) {
-        text += line + "\n";
+//выгрузка всех библиотек при завершении программы
+void unloadCipherRegistry(CipherRegistry& registry) {
+#ifndef CIPHER_STATIC_BUILD
+    for (int i = 0; i < CIPHER_COUNT; i++) {
+        unloadCipherLibrary(registry.ciphers[i]);
     }
-    if (!text.empty()) text.pop_back();
+#else
+    (void)registry;
+#endif
+}
 
-    string result = cipherFuncs.encryptText(text, key, true);
-    out << result;
+//получение функций шифра из реестра; nullptr, если библиотека недоступна
+const CipherFunctions* findCipher(const CipherRegistry& registry, CipherMethod method, string& error) {
+    int index = static_cast<int>(method) - 1;
+    if (index < 0 || index >= CIPHER_COUNT) {
+        error = "Неизвестный метод шифрования";
+        return nullptr;
+    }
+    const CipherFunctions& funcs = registry.ciphers[index];
+    if (!funcs.encryptText || !funcs.decryptText) {
+        error = registry.loadErrors[index];
+        return nullptr;
+    }
+    return &funcs;
 }
 
-void decryptTextFile(const string& inputFile, const string& outputFile, const string& key, 
-                    CipherFunctions& cipherFuncs) {
-    ifstream in(inputFile);
-    ofstream out(outputFile);
-    if (!in) throw runtime_error("Не удалось открыть файл " + inputFile);
-    if (!out) throw runtime_error("Не удалось создать файл " + outputFile);
+//параметры конвейера для преобразования, переносящего состояние между
+//блоками (контекст шифра): один рабочий поток обрабатывает блоки по порядку
+PipelineOptions sequentialPipeline() {
+    PipelineOptions options;
+    options.chunkSize = STREAM_CHUNK_SIZE;
+    options.workers = usePipeline ? 1 : 0;
+    return options;
+}
 
-    if (!cipherFuncs.decryptText) {
-        throw runtime_error("Шифр недоступен");
+//потоковая обработка текстового файла через контекст шифра: файл читается
+//большими блоками, контекст переносит позицию ключа и неполную кириллическую
+//пару между блоками, результат пишется по мере готовности. Чтение и запись
+//идут параллельно с шифрованием. Как и при построчном чтении, завершающий
+//перевод строки файла в шифр не передаётся
+void streamTextFile(int inFd, int outFd, const string& key, bool decrypt, const CipherFunctions& cipherFuncs) {
+    //контекст создаётся при первых данных: пустой файл, как и раньше,
+    //даёт пустой результат без проверки ключа
+    void* ctx = nullptr;
+    bool heldNewline = false;
+    
+    try {
+        runFilePipeline(inFd, outFd, sequentialPipeline(), [&](PipelineChunk& chunk) {
+            string& result = chunk.output;
+            result.clear();
+            auto feed = [&](const string& data) {
+                ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, data.size());
+                if (!ctx) ctx = cipherFuncs.contextInit(key, decrypt, false, true);
+                result += cipherFuncs.contextUpdate(ctx, data);
+            };
+            
+            //отложенный перевод строки оказался не последним в файле
+            if (heldNewline) {
+                feed("\n");
+                heldNewline = false;
+            }
+            chunk.buffer.resize(chunk.length);
+            if (chunk.buffer.back() == '\n') {
+                chunk.buffer.pop_back();
+                heldNewline = true;
+            }
+            if (!chunk.buffer.empty()) feed(chunk.buffer);
+            
+            chunk.result = result.data();
+            chunk.resultLength = result.size();
+        });
+    } catch (...) {
+        if (ctx) cipherFuncs.contextFinal(ctx);
+        throw;
     }
+    
+    if (ctx) {
+        string tail;
+        {
+            ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, 0);
+            tail = cipherFuncs.contextFinal(ctx);
+        }
+        writeAll(outFd, tail.data(), tail.size());
+    }
+}
 
+//обработка текста из inFd в outFd: через контекст шифра или, если
+//библиотека без контекстов, весь текст одним вызовом. Завершающий перевод
+//строки в шифр не передаётся - одно правило для меню, командной строки
+//и пакетной обработки
+void transformTextStream(int inFd, int outFd, const string& key, bool decrypt, const CipherFunctions& cipherFuncs) {
+    string (*transform)(const string&, const string&, bool) = decrypt ? cipherFuncs.decryptText : cipherFuncs.encryptText;
+    if (!transform) {
+        throw runtime_error("Шифр недоступен");
+    }
+    
+    if (cipherFuncs.contextInit && cipherFuncs.contextUpdate && cipherFuncs.contextFinal) {
+        streamTextFile(inFd, outFd, key, decrypt, cipherFuncs);
+        return;
+    }
+    
     string text;
-    string line;
-    while (getline(in, line)) {
-        text += line + "\n";
+    string chunk(STREAM_CHUNK_SIZE, '\0');
+    while (size_t bytesRead = readFull(inFd, &chunk[0], chunk.size())) {
+        text.append(chunk, 0, bytesRead);
     }
-    if (!text.empty()) text.pop_back();
+    if (!text.empty() && text.back() == '\n') text.pop_back();
+    
+    string result;
+    {
+        ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, text.size());
+        result = transform(text, key, true);
+    }
+    writeAll(outFd, result.data(), result.size());
+}
 
-    string result = cipherFuncs.decryptText(text, key, true);
-    out << result;
+//вход и выход - один и тот же файл (совпадают устройство и индексный узел).
+//Выход, которого ещё нет, со входом не совпадает
+bool isSameFile(const string& first, const string& second) {
+    struct stat firstInfo, secondInfo;
+    if (stat(first.c_str(), &firstInfo) != 0 || stat(second.c_str(), &secondInfo) != 0) return false;
+    return firstInfo.st_dev == secondInfo.st_dev && firstInfo.st_ino == secondInfo.st_ino;
 }
 
-//для бинарных файлов
-void encryptBinaryFile(const string& inputFile, const string& outputFile, const string& key, CipherFunctions& cipherFuncs) {
-    ifstream in(inputFile, ios::binary);
-    ofstream out(outputFile, ios::binary);
-    if (!in) throw runtime_error("Не удалось открыть файл " + inputFile);
-    if (!out) throw runtime_error("Не удалось создать файл " + outputFile);
-    if (key.empty()) throw runtime_error("Ключ не должен быть пустым");
+//результат поверх входа: transform пишет во временный файл рядом с выходом,
+//который после успешной обработки переименовывается в выходной. До этого
+//вход не меняется, права доступа файла сохраняются
+void replaceThroughTemporary(const string& inputFile, const string& outputFile,
+                             const function<void(const string&)>& transform) {
+    char* resolved = realpath(outputFile.c_str(), nullptr);
+    string target = resolved ? resolved : outputFile;
+    free(resolved);
+    
+    string temporary = target + ".XXXXXX";
+    int fd = mkstemp(&temporary[0]);
+    if (fd < 0) throw runtime_error("Не удалось создать временный файл для " + outputFile);
+    struct stat info;
+    if (stat(inputFile.c_str(), &info) == 0) fchmod(fd, info.st_mode & 07777);
+    close(fd);
+    
+    try {
+        transform(temporary);
+        if (rename(temporary.c_str(), target.c_str()) != 0) {
+            throw runtime_error("Не удалось заменить файл " + outputFile + ": " + strerror(errno));
+        }
+    } catch (...) {
+        unlink(temporary.c_str());
+        throw;
+    }
+}
+
+//функции для работы с текстовыми файлами
+void transformTextFile(const string& inputFile, const string& outputFile, const string& key, bool decrypt,
+                       const CipherFunctions& cipherFuncs) {
+    if (isSameFile(inputFile, outputFile)) {
+        replaceThroughTemporary(inputFile, outputFile, [&](const string& temporary) {
+            transformTextFile(inputFile, temporary, key, decrypt, cipherFuncs);
+        });
+        return;
+    }
+    
+    ScopedMetric metric(programMetrics(), PROGRAM_METRIC_FILE, 0);
+    if (!(decrypt ? cipherFuncs.decryptText : cipherFuncs.encryptText)) {
+        throw runtime_error("Шифр недоступен");
+    }
+    
+    int inFd = open(inputFile.c_str(), O_RDONLY);
+    int outFd = open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (inFd < 0) {
+        if (outFd >= 0) close(outFd);
+        throw runtime_error("Не удалось открыть файл " + inputFile);
+    }
+    if (outFd < 0) {
+        close(inFd);
+        throw runtime_error("Не удалось создать файл " + outputFile);
+    }
+    
+    try {
+        transformTextStream(inFd, outFd, key, decrypt, cipherFuncs);
+    } catch (...) {
+        close(inFd);
+        close(outFd);
+        throw;
+    }
+    
+    close(inFd);
+    if (close(outFd) != 0) throw runtime_error("Ошибка записи в файл " + outputFile);
+}
+
+void encryptTextFile(const string& inputFile, const string& outputFile, const string& key, 
+                    const CipherFunctions& cipherFuncs) {
+    transformTextFile(inputFile, outputFile, key, false, cipherFuncs);
+}
 
-    //если есть специальная бинарная функция, используем её
-    if (cipherFuncs.encryptBinary) {
-        string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
-        string result = cipherFuncs.encryptBinary(content, key);
-        out.write(result.data(), result.size());
+void decryptTextFile(const string& inputFile, const string& outputFile, const string& key, 
+                    const CipherFunctions& cipherFuncs) {
+    transformTextFile(inputFile, outputFile, key, true, cipherFuncs);
+}
+
+//ошибка функции буферного интерфейса шифра
+void checkPluginStatus(int status, const CipherPluginDescriptor* descriptor) {
+    if (status != CIPHER_OK) {
+        throw runtime_error(descriptor->lastError());
     }
-    //для Виженера и Гронсфельда используем специальную бинарную обработку
-    else if (cipherFuncs.encryptText) {
-        string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+//может ли шифр писать бинарный результат поверх входа
+bool binaryInPlace(const CipherPluginDescriptor* descriptor) {
+    return (descriptor->capabilities & CIPHER_CAP_IN_PLACE_BINARY) && descriptor->sizeRule == CIPHER_SIZE_SAME;
+}
+
+//обработка отображённого файла на месте: частное отображение с правом записи
+//служит и входом, и выходом, результат пишется в файл обычной записью.
+//Потоковые шифры обрабатывают файл окнами, страницы готового окна сразу
+//освобождаются, так что в памяти находится не больше одного окна.
+//Выходной файл обрезается только в конце: если это тот же файл, что и вход,
+//каждое окно перезаписывается уже после того, как оно прочитано
+bool transformMappedFileInPlace(const string& inputFile, const string& outputFile, const string& key,
+                                const CipherPluginDescriptor* descriptor, CipherTransformFunction transform) {
+    MappedInput input;
+    {
+        ScopedMetric metric(programMetrics(), PROGRAM_METRIC_MAP, 0);
+        if (!mapInputFile(inputFile, input, true)) return false;
+    }
+    
+    int outFd = open(outputFile.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (outFd < 0) throw runtime_error("Не удалось создать файл " + outputFile);
+    
+    const uint8_t* keyData = reinterpret_cast<const uint8_t*>(key.data());
+    bool streaming = (descriptor->capabilities & CIPHER_CAP_STREAMING) != 0;
+    size_t window = streaming ? MAPPED_WINDOW_SIZE : input.size;
+    size_t total = 0;
+    
+    try {
+        for (size_t offset = 0; offset < input.size; offset += window) {
+            size_t length = min(window, input.size - offset);
+            uint8_t* chunk = reinterpret_cast<uint8_t*>(input.data + offset);
+            size_t written = 0;
+            {
+                ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, length);
+                checkPluginStatus(transform(chunk, length, keyData, key.size(), offset, chunk, length, &written), descriptor);
+            }
+            writeAll(outFd, input.data + offset, written);
+            total += written;
+            if (streaming) releaseMappedRange(input, offset, length);
+        }
+        
+        if (ftruncate(outFd, total) != 0) {
+            throw runtime_error(string("Не удалось обрезать выходной файл: ") + strerror(errno));
+        }
+    } catch (...) {
+        close(outFd);
+        throw;
+    }
+    
+    if (close(outFd) != 0) throw runtime_error("Ошибка записи в файл " + outputFile);
+    return true;
+}
+
+//потоковая обработка бинарных данных через буферный интерфейс шифра
+//(CIPHER_CAP_STREAMING): каждый блок несёт свою позицию в потоке, поэтому
+//шифр, допускающий одновременные вызовы, получает второй рабочий поток -
+//он начинает следующий блок, пока первый заканчивает свой. Остальное
+//распараллеливание делает сам шифр внутри блока. reader - источник блоков
+//вместо последовательного чтения inFd (см. ChunkReader)
+void streamBinaryWithPlugin(int inFd, int outFd, const string& key, const CipherPluginDescriptor* descriptor, bool decrypt,
+                            const ChunkReader& reader = ChunkReader()) {
+    CipherTransformFunction transform = decrypt ? descriptor->decryptBinary : descriptor->encryptBinary;
+    const uint8_t* keyData = reinterpret_cast<const uint8_t*>(key.data());
+    bool inPlace = binaryInPlace(descriptor);
+    size_t outCapacity = inPlace ? 0 : descriptor->outputSize(STREAM_CHUNK_SIZE, keyData, key.size(), decrypt, 1);
+    
+    PipelineOptions options = sequentialPipeline();
+    if (usePipeline && (descriptor->capabilities & CIPHER_CAP_PARALLEL_SAFE)) options.workers = 2;
+    options.reader = reader;
+    
+    runFilePipeline(inFd, outFd, options, [&](PipelineChunk& chunk) {
+        //на месте - без второго буфера
+        uint8_t* data = reinterpret_cast<uint8_t*>(&chunk.buffer[0]);
+        uint8_t* out = data;
+        size_t capacity = chunk.buffer.size();
+        if (!inPlace) {
+            chunk.output.resize(outCapacity);
+            out = reinterpret_cast<uint8_t*>(&chunk.output[0]);
+            capacity = chunk.output.size();
+        }
         
-        //для бинарных данных отключаем кириллицу и используем простое сложение по модулю 256
-        string result;
-        if (cipherFuncs.encryptText) {
-            //создаем простой шифр для бинарных данных
-            size_t keyLen = key.size();
-            for (size_t i = 0; i < content.length(); ++i) {
-                unsigned char b = static_cast<unsigned char>(content[i]);
-                unsigned char k = static_cast<unsigned char>(key[i % keyLen]);
-                result += static_cast<char>((b + k) % 256);
+        size_t written = 0;
+        ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, chunk.length);
+        checkPluginStatus(transform(data, chunk.length, keyData, key.size(), chunk.offset,
+                                    out, capacity, &written), descriptor);
+        chunk.result = reinterpret_cast<const char*>(out);
+        chunk.resultLength = written;
+    });
+}
+
+//обработка бинарного файла через буферный интерфейс шифра. Путь выбирается
+//по возможностям библиотеки: отображение файлов в память (на месте, если
+//шифр это допускает), потоковая обработка блоками или чтение файла целиком
+void transformBinaryFileWithPlugin(const string& inputFile, const string& outputFile, const string& key,
+                                   const CipherPluginDescriptor* descriptor, bool decrypt) {
+    CipherTransformFunction transform = decrypt ? descriptor->decryptBinary : descriptor->encryptBinary;
+    const uint8_t* keyData = reinterpret_cast<const uint8_t*>(key.data());
+    bool inPlace = binaryInPlace(descriptor);
+    size_t written = 0;
+    
+    if (useMappedFiles && inPlace) {
+        if (transformMappedFileInPlace(inputFile, outputFile, key, descriptor, transform)) return;
+    } else if (useMappedFiles) {
+        MappedInput input;
+        MappedOutput output;
+        bool mapped;
+        {
+            ScopedMetric metric(programMetrics(), PROGRAM_METRIC_MAP, 0);
+            mapped = mapInputFile(inputFile, input);
+            if (mapped) mapOutputFile(outputFile, descriptor->outputSize(input.size, keyData, key.size(), decrypt, 1), output);
+        }
+        if (mapped) {
+            {
+                ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, input.size);
+                checkPluginStatus(transform(reinterpret_cast<const uint8_t*>(input.data), input.size, keyData, key.size(), 0,
+                                            reinterpret_cast<uint8_t*>(output.data), output.size, &written), descriptor);
             }
+            ScopedMetric metric(programMetrics(), PROGRAM_METRIC_MAP, 0);
+            finishOutputFile(output, written);
+            return;
         }
-        out.write(result.data(), result.size());
     }
-    else {
-        throw runtime_error("Шифр недоступен для бинарных данных");
+    
+    int inFd = open(inputFile.c_str(), O_RDONLY);
+    if (inFd < 0) throw runtime_error("Не удалось открыть файл " + inputFile);
+    int outFd = open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (outFd < 0) {
+        close(inFd);
+        throw runtime_error("Не удалось создать файл " + outputFile);
+    }
+    
+    try {
+        if (descriptor->capabilities & CIPHER_CAP_STREAMING) {
+            streamBinaryWithPlugin(inFd, outFd, key, descriptor, decrypt);
+        } else {
+            vector<uint8_t> content;
+            size_t size = 0;
+            while (true) {
+                content.resize(size + STREAM_CHUNK_SIZE);
+                size_t bytesRead = readFull(inFd, reinterpret_cast<char*>(content.data()) + size, STREAM_CHUNK_SIZE);
+                size += bytesRead;
+                if (bytesRead < STREAM_CHUNK_SIZE) break;
+            }
+            
+            vector<uint8_t> result(inPlace ? 0 : descriptor->outputSize(size, keyData, key.size(), decrypt, 1));
+            uint8_t* out = inPlace ? content.data() : result.data();
+            size_t outCapacity = inPlace ? content.size() : result.size();
+            {
+                ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, size);
+                checkPluginStatus(transform(content.data(), size, keyData, key.size(), 0,
+                                            out, outCapacity, &written), descriptor);
+            }
+            writeAll(outFd, reinterpret_cast<const char*>(out), written);
+        }
+    } catch (...) {
+        close(inFd);
+        close(outFd);
+        throw;
     }
+    
+    close(inFd);
+    if (close(outFd) != 0) throw runtime_error("Ошибка записи в файл " + outputFile);
 }
 
-void decryptBinaryFile(const string& inputFile, const string& outputFile, const string& key, CipherFunctions& cipherFuncs) {
+//для бинарных файлов: библиотеки с описанием работают через буферный
+//интерфейс, остальные получают файл целиком строковой функцией
+void transformBinaryFile(const string& inputFile, const string& outputFile, const string& key, bool decrypt,
+                         const CipherFunctions& cipherFuncs) {
+    //поверх входа без временного файла пишет только обработка на месте
+    //(она перезаписывает каждое окно уже после чтения); остальные пути
+    //обрезают выход до того, как прочитан вход
+    const CipherPluginDescriptor* descriptor = cipherFuncs.descriptor;
+    if (isSameFile(inputFile, outputFile) && !(descriptor && useMappedFiles && binaryInPlace(descriptor))) {
+        replaceThroughTemporary(inputFile, outputFile, [&](const string& temporary) {
+            transformBinaryFile(inputFile, temporary, key, decrypt, cipherFuncs);
+        });
+        return;
+    }
+    
+    ScopedMetric metric(programMetrics(), PROGRAM_METRIC_FILE, 0);
+    if (key.empty()) throw runtime_error("Ключ не должен быть пустым");
+    if (cipherFuncs.descriptor) {
+        transformBinaryFileWithPlugin(inputFile, outputFile, key, cipherFuncs.descriptor, decrypt);
+        return;
+    }
+    
+    string (*transform)(const string&, const string&) = decrypt ? cipherFuncs.decryptBinary : cipherFuncs.encryptBinary;
+    if (!transform) throw runtime_error("Шифр недоступен для бинарных данных");
+    
     ifstream in(inputFile, ios::binary);
-    ofstream out(outputFile, ios::binary);
     if (!in) throw runtime_error("Не удалось открыть файл " + inputFile);
+    ofstream out(outputFile, ios::binary);
     if (!out) throw runtime_error("Не удалось создать файл " + outputFile);
-    if (key.empty()) throw runtime_error("Ключ не должен быть пустым");
+    
+    string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    string result;
+    {
+        ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, content.size());
+        result = transform(content, key);
+    }
+    out.write(result.data(), result.size());
+    if (!out) throw runtime_error("Ошибка записи в файл " + outputFile);
+}
+
+void encryptBinaryFile(const string& inputFile, const string& outputFile, const string& key, const CipherFunctions& cipherFuncs) {
+    transformBinaryFile(inputFile, outputFile, key, false, cipherFuncs);
+}
+
+void decryptBinaryFile(const string& inputFile, const string& outputFile, const string& key, const CipherFunctions& cipherFuncs) {
+    transformBinaryFile(inputFile, outputFile, key, true, cipherFuncs);
+}
 
-    //если есть специальная бинарная функция, используем её
-    if (cipherFuncs.decryptBinary) {
-        string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
-        string result = cipherFuncs.decryptBinary(content, key);
-        out.write(result.data(), result.size());
+//обработка диапазона [offset, offset + length) бинарного файла потоковым
+//шифром: ключ в каждой позиции зависит только от самой позиции, поэтому
+//данные до начала диапазона не читаются - вход перематывается на offset,
+//и шифр получает блоки с их позицией в файле. Диапазон, выходящий за конец
+//файла, обрезается. Вход должен допускать произвольный доступ
+void transformFileRange(int inFd, int outFd, const string& key, uint64_t offset, uint64_t length, bool decrypt,
+                        const CipherFunctions& cipherFuncs) {
+    const CipherPluginDescriptor* descriptor = cipherFuncs.descriptor;
+    if (!descriptor || !(descriptor->capabilities & CIPHER_CAP_STREAMING)) {
+        throw runtime_error("Шифр не поддерживает обработку диапазона: результат зависит от всех данных");
+    }
+    if (key.empty()) throw runtime_error("Ключ не должен быть пустым");
+    
+    struct stat info;
+    if (fstat(inFd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        throw runtime_error("Диапазон читается только из файла");
+    }
+    uint64_t size = info.st_size;
+    if (offset > size) throw runtime_error("Начало диапазона за концом файла");
+    uint64_t end = offset + min(length, size - offset);
+    if (lseek(inFd, offset, SEEK_SET) < 0) {
+        throw runtime_error(string("Не удалось перейти к началу диапазона: ") + strerror(errno));
     }
-    //для Виженера и Гронсфельда используем специальную бинарную обработку
-    else if (cipherFuncs.decryptText) {
-        string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    
+    //диапазон в один блок обрабатывается сразу в текущем потоке: для коротких
+    //чтений запуск потоков конвейера дольше самой работы
+    if (end - offset <= STREAM_CHUNK_SIZE) {
+        CipherTransformFunction transform = decrypt ? descriptor->decryptBinary : descriptor->encryptBinary;
+        const uint8_t* keyData = reinterpret_cast<const uint8_t*>(key.data());
+        size_t count = static_cast<size_t>(end - offset);
+        vector<uint8_t> data(count);
+        if (readFull(inFd, reinterpret_cast<char*>(data.data()), count) != count) {
+            throw runtime_error("Файл изменился во время чтения");
+        }
         
-        //для бинарных данных отключаем кириллицу и используем простое вычитание по модулю 256
-        string result;
-        if (cipherFuncs.decryptText) {
-            size_t keyLen = key.size();
-            for (size_t i = 0; i < content.length(); ++i) {
-                unsigned char b = static_cast<unsigned char>(content[i]);
-                unsigned char k = static_cast<unsigned char>(key[i % keyLen]);
-                result += static_cast<char>((b - k + 256) % 256);
-            }
+        vector<uint8_t> result(binaryInPlace(descriptor) ? 0 : descriptor->outputSize(count, keyData, key.size(), decrypt, 1));
+        uint8_t* out = result.empty() ? data.data() : result.data();
+        size_t written = 0;
+        {
+            ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, count);
+            checkPluginStatus(transform(data.data(), count, keyData, key.size(), offset,
+                                        out, result.empty() ? data.size() : result.size(), &written), descriptor);
         }
-        out.write(result.data(), result.size());
-    }
-    else {
-        throw runtime_error("Шифр недоступен для бинарных данных");
+        writeAll(outFd, reinterpret_cast<const char*>(out), written);
+        return;
     }
+    
+    //блоки читаются подряд от начала диапазона до его конца
+    uint64_t position = offset;
+    streamBinaryWithPlugin(inFd, outFd, key, descriptor, decrypt, [&](PipelineChunk& chunk) {
+        if (position >= end) return false;
+        size_t count = static_cast<size_t>(min<uint64_t>(STREAM_CHUNK_SIZE, end - position));
+        if (chunk.buffer.size() < count) chunk.buffer.resize(count);
+        chunk.length = readFull(inFd, &chunk.buffer[0], count);
+        if (chunk.length != count) throw runtime_error("Файл изменился во время чтения");
+        chunk.offset = position;
+        position += count;
+        return true;
+    });
 }
 
 //шифрование текста
-string encryptText(const string& text, const string& key, CipherFunctions& cipherFuncs) {
+string encryptText(const string& text, const string& key, const CipherFunctions& cipherFuncs) {
     if (!cipherFuncs.encryptText) {
         throw runtime_error("Шифр недоступен");
     }
@@ -251,10 +808,488 @@ void saveTextToFile(const string& text, const string& filename) {
     cout << "Текст успешно сохранён в файл: " << filename << endl;
 }
 
-int main() {
+//потоковая обработка через контекст шифра: данные читаются блоками,
+//результат каждого блока сразу пишется в выходной дескриптор. Бинарные
+//данные потоковых шифров идут через буферный интерфейс без контекста
+void streamWithContext(int inFd, int outFd, const string& key, bool decrypt, bool binary, const CipherFunctions& cipherFuncs) {
+    if (binary && !key.empty() && cipherFuncs.descriptor &&
+        (cipherFuncs.descriptor->capabilities & CIPHER_CAP_STREAMING)) {
+        streamBinaryWithPlugin(inFd, outFd, key, cipherFuncs.descriptor, decrypt);
+        return;
+    }
+    if (!cipherFuncs.contextInit || !cipherFuncs.contextUpdate || !cipherFuncs.contextFinal) {
+        throw runtime_error("Шифр не поддерживает потоковую обработку");
+    }
+    
+    void* ctx = cipherFuncs.contextInit(key, decrypt, binary, true);
+    try {
+        runFilePipeline(inFd, outFd, sequentialPipeline(), [&](PipelineChunk& chunk) {
+            chunk.buffer.resize(chunk.length);
+            ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, chunk.length);
+            chunk.output = cipherFuncs.contextUpdate(ctx, chunk.buffer);
+            chunk.result = chunk.output.data();
+            chunk.resultLength = chunk.output.size();
+        });
+    } catch (...) {
+        cipherFuncs.contextFinal(ctx);
+        throw;
+    }
+    
+    string tail;
+    {
+        ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, 0);
+        tail = cipherFuncs.contextFinal(ctx);
+    }
+    writeAll(outFd, tail.data(), tail.size());
+}
+
+//шифрование или расшифровка контейнера через буферный интерфейс шифра.
+//Блоки независимы, поэтому их обрабатывает столько потоков, сколько
+//задано для шифра
+void transformContainer(int inFd, int outFd, const string& key, CipherMethod method, bool decrypt,
+                        const CipherFunctions& cipherFuncs) {
+    if (!cipherFuncs.descriptor) {
+        throw runtime_error("Шифр не поддерживает формат контейнера");
+    }
+    
+    ContainerOptions options;
+    options.chunkSize = containerChunkSize;
+    options.workers = usePipeline ? (cipherThreads ? cipherThreads : max(1u, thread::hardware_concurrency())) : 0;
+    uint32_t cipherId = static_cast<uint32_t>(method);
+    if (decrypt) {
+        decryptContainer(inFd, outFd, cipherId, key, cipherFuncs.descriptor, options);
+    } else {
+        encryptContainer(inFd, outFd, cipherId, key, cipherFuncs.descriptor, options);
+    }
+}
+
+//путь результата пакетной обработки: имя входного файла в каталоге outputDir
+string batchOutputPath(const string& outputDir, const string& inputFile) {
+    size_t slash = inputFile.find_last_of('/');
+    string name = slash == string::npos ? inputFile : inputFile.substr(slash + 1);
+    return outputDir + "/" + name;
+}
+
+//пакетная обработка файлов в каталог outputDir. С useUring небольшие файлы
+//идут через io_uring с буферным интерфейсом шифра; файлы крупнее буфера
+//пакета, а если io_uring недоступен - все файлы, обрабатываются обычным
+//файловым путём.
+//Ошибка одного файла не останавливает остальные. Возвращает код завершения
+int transformFileBatch(const vector<string>& inputFiles, const string& outputDir, const string& key,
+                       bool decrypt, bool binary, const CipherFunctions& cipherFuncs) {
+    vector<BatchJob> jobs(inputFiles.size());
+    for (size_t i = 0; i < inputFiles.size(); i++) {
+        jobs[i].input = inputFiles[i];
+        jobs[i].output = batchOutputPath(outputDir, inputFiles[i]);
+    }
+    
+    const CipherPluginDescriptor* descriptor = cipherFuncs.descriptor;
+    bool batched = false;
+    if (useUring && descriptor && !key.empty()) {
+        CipherTransformFunction transform = binary ? (decrypt ? descriptor->decryptBinary : descriptor->encryptBinary)
+                                                   : (decrypt ? descriptor->decryptText : descriptor->encryptText);
+        const uint8_t* keyData = reinterpret_cast<const uint8_t*>(key.data());
+        BatchOptions options;
+        options.inPlace = binary ? binaryInPlace(descriptor)
+                                 : (descriptor->capabilities & CIPHER_CAP_IN_PLACE_TEXT) &&
+                                   descriptor->sizeRule == CIPHER_SIZE_SAME;
+        
+        batched = runUringBatch(jobs, options, [&](uint8_t* data, size_t length, uint8_t* out, size_t capacity) -> size_t {
+            //как и при обычной обработке, завершающий перевод строки текста в шифр не передаётся
+            if (!binary && length > 0 && data[length - 1] == '\n') length--;
+            if (descriptor->outputSize(length, keyData, key.size(), decrypt, binary) > capacity) return BATCH_DEFER;
+            
+            ScopedMetric metric(programMetrics(), PROGRAM_METRIC_CIPHER, length);
+            size_t written = 0;
+            checkPluginStatus(transform(data, length, keyData, key.size(), 0, out, capacity, &written), descriptor);
+            return written;
+        });
+    }
+    
+    int status = 0;
+    for (BatchJob& job : jobs) {
+        if (!batched || job.deferred) {
+            try {
+                if (binary) {
+                    if (decrypt) {
+                        decryptBinaryFile(job.input, job.output, key, cipherFuncs);
+                    } else {
+                        encryptBinaryFile(job.input, job.output, key, cipherFuncs);
+                    }
+                } else {
+                    transformTextFile(job.input, job.output, key, decrypt, cipherFuncs);
+                }
+            } catch (const exception& e) {
+                job.error = e.what();
+            }
+        }
+        if (!job.error.empty()) {
+            cerr << "Ошибка (" << job.input << "): " << job.error << endl;
+            status = 1;
+        }
+    }
+    return status;
+}
+
+//включение счётчиков программы; счётчики загруженных шифров включаются,
+//если передан реестр
+void enableMetrics(const CipherRegistry* registry) {
+    enableAllocationCounting();
+    programMetrics().setEnabled(true);
+    if (!registry) return;
+    for (int i = 0; i < CIPHER_COUNT; i++) {
+        const CipherPluginDescriptor* descriptor = registry->ciphers[i].descriptor;
+        if (descriptor && CIPHER_PLUGIN_HAS_FIELD(descriptor, setMetricsEnabled)) descriptor->setMetricsEnabled(1);
+    }
+}
+
+//отчёт о счётчиках программы и шифров в поток ошибок (стандартный
+//вывод может быть занят данными)
+void printStats(const CipherRegistry& registry, StatsFormat format) {
+    vector<string> programNames(PROGRAM_METRIC_NAMES, PROGRAM_METRIC_NAMES + PROGRAM_METRIC_COUNT);
+    vector<string> cipherNames(CIPHER_METRIC_NAMES, CIPHER_METRIC_NAMES + CIPHER_METRIC_OPERATIONS);
+    vector<OperationMetrics> program = programMetrics().snapshot();
+    
+    if (format == StatsFormat::JSON) {
+        cerr << "{\"program\": ";
+        printMetricsJson(cerr, programNames, program);
+        cerr << ", \"ciphers\": {";
+    } else {
+        cerr << "=== Статистика ===\n";
+        printMetricsText(cerr, "Программа", programNames, program);
+    }
+    
+    bool first = true;
+    for (int i = 0; i < CIPHER_COUNT; i++) {
+        const CipherPluginDescriptor* descriptor = registry.ciphers[i].descriptor;
+        if (!descriptor) continue;
+        //библиотека без счётчиков вызовов показывается без операций
+        CipherMetrics metrics = CipherMetrics();
+        if (CIPHER_PLUGIN_HAS_FIELD(descriptor, metrics)) descriptor->metrics(&metrics);
+        //библиотека без кэша ключей (описание первой версии) - строки кэша нет
+        bool hasCache = CIPHER_PLUGIN_HAS_FIELD(descriptor, keyCacheStats);
+        CipherKeyCacheStats cache = CipherKeyCacheStats();
+        if (hasCache) descriptor->keyCacheStats(&cache);
+        
+        if (format == StatsFormat::JSON) {
+            cerr << (first ? "" : ", ") << '"' << descriptor->name << "\": {\"operations\": ";
+            printMetricsJson(cerr, cipherNames, cipherOperationMetrics(metrics));
+            if (hasCache) {
+                cerr << ", \"key_cache\": {\"hits\": " << cache.hits << ", \"misses\": " << cache.misses
+                     << ", \"entries\": " << cache.entries << ", \"capacity\": " << cache.capacity << "}";
+            }
+            cerr << "}";
+        } else {
+            printMetricsText(cerr, string("Шифр ") + descriptor->name, cipherNames, cipherOperationMetrics(metrics));
+            if (hasCache) {
+                cerr << "  кэш ключей: попаданий " << cache.hits << ", промахов " << cache.misses
+                     << ", ключей " << cache.entries << " из " << cache.capacity << '\n';
+            }
+        }
+        first = false;
+    }
+    
+    if (format == StatsFormat::JSON) cerr << "}}";
+    cerr << endl;
+}
+
+//справка по параметрам командной строки
+void printUsage(const char* program) {
+    cerr << "Использование: " << program << " -c ШИФР (-e | -d) -k КЛЮЧ [-t text|binary] [-i ВХОД] [-o ВЫХОД]\n"
+         << "       " << program << " -c ШИФР (-e | -d) -k КЛЮЧ [-t text|binary] -b КАТАЛОГ ФАЙЛ...\n"
+         << "  -c, --cipher    permutation | vigenere | gronsfeld (или 1 | 2 | 3)\n"
+         << "  -e, --encrypt   шифрование\n"
+         << "  -d, --decrypt   дешифрование\n"
+         << "  -k, --key       ключ\n"
+         << "  -t, --type      тип данных: text (по умолчанию) или binary\n"
+         << "  -i, --input     входной файл, '-' - стандартный ввод (по умолчанию)\n"
+         << "  -o, --output    выходной файл, '-' - стандартный вывод (по умолчанию)\n"
+         << "  -j, --threads   число потоков для бинарных данных (0 - по числу ядер)\n"
+         << "      --no-mmap   не использовать отображение файлов в память\n"
+         << "      --no-pipeline  читать, шифровать и писать по очереди, без отдельных потоков\n"
+         << "  -b, --batch     каталог для результатов пакетной обработки ФАЙЛОВ (имена сохраняются)\n"
+         << "      --uring     обрабатывать пакет файлов через io_uring (если ядро его поддерживает)\n"
+         << "      --container бинарные данные в формате контейнера: заголовок с длиной, независимо\n"
+         << "                  зашифрованные блоки и индекс блоков (расшифровка - только из файла)\n"
+         << "      --chunk-size РАЗМЕР  размер блока контейнера в байтах (по умолчанию 1048576)\n"
+         << "      --offset N  обработать бинарный файл начиная с байта N (Виженер и Гронсфельд):\n"
+         << "                  данные до N не читаются\n"
+         << "      --length N  обработать не больше N байт (с --offset или с начала файла)\n"
+         << "      --stats[=text|json]  при завершении вывести в поток ошибок счётчики работы программы и шифров\n"
+         << "  -h, --help      эта справка\n"
+         << "Без параметров запускается интерактивное меню." << endl;
+}
+
+//разбор неотрицательного десятичного числа не больше maxValue; false -
+//строка не число целиком (пустая, со знаком, с лишними символами) или
+//число слишком велико
+bool parseNumber(const char* text, uint64_t maxValue, uint64_t& value) {
+    if (*text < '0' || *text > '9') return false;
+    char* end;
+    errno = 0;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    if (errno != 0 || *end != '\0' || parsed > maxValue) return false;
+    value = parsed;
+    return true;
+}
+
+//разбор названия шифра
+bool parseCipherMethod(const string& name, CipherMethod& method) {
+    if (name == "permutation" || name == "1") {
+        method = CipherMethod::PERMUTATION;
+    } else if (name == "vigenere" || name == "2") {
+        method = CipherMethod::VIGENERE;
+    } else if (name == "gronsfeld" || name == "3") {
+        method = CipherMethod::GRONSFELD;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//неинтерактивный режим: все параметры задаются флагами, данные
+//передаются потоком, поэтому программу можно ставить в конвейер
+int runCommandLine(int argc, char* argv[]) {
+    static const option longOptions[] = {
+        {"cipher", required_argument, nullptr, 'c'},
+        {"encrypt", no_argument, nullptr, 'e'},
+        {"decrypt", no_argument, nullptr, 'd'},
+        {"key", required_argument, nullptr, 'k'},
+        {"type", required_argument, nullptr, 't'},
+        {"input", required_argument, nullptr, 'i'},
+        {"output", required_argument, nullptr, 'o'},
+        {"threads", required_argument, nullptr, 'j'},
+        {"no-mmap", no_argument, nullptr, 'M'},
+        {"no-pipeline", no_argument, nullptr, 'P'},
+        {"batch", required_argument, nullptr, 'b'},
+        {"uring", no_argument, nullptr, 'U'},
+        {"stats", optional_argument, nullptr, 'S'},
+        {"container", no_argument, nullptr, 'C'},
+        {"chunk-size", required_argument, nullptr, 'Z'},
+        {"offset", required_argument, nullptr, 'O'},
+        {"length", required_argument, nullptr, 'L'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    
+    CipherMethod method = CipherMethod::VIGENERE;
+    bool hasCipher = false;
+    int direction = 0;          //1 - шифрование, -1 - дешифрование
+    string key;
+    bool hasKey = false;
+    FileType fileType = FileType::TEXT;
+    string inputFile = "-";
+    string outputFile = "-";
+    string batchDir;
+    bool hasRange = false;
+    uint64_t rangeOffset = 0;
+    uint64_t rangeLength = UINT64_MAX;
+    
+    int opt;
+    while ((opt = getopt_long(argc, argv, "c:edk:t:i:o:j:b:h", longOptions, nullptr)) != -1) {
+        switch (opt) {
+            case 'c':
+                if (!parseCipherMethod(optarg, method)) {
+                    cerr << "Неизвестный шифр: " << optarg << endl;
+                    return 2;
+                }
+                hasCipher = true;
+                break;
+            case 'e':
+                direction = 1;
+                break;
+            case 'd':
+                direction = -1;
+                break;
+            case 'k':
+                key = optarg;
+                hasKey = true;
+                break;
+            case 't':
+                if (string(optarg) == "text") {
+                    fileType = FileType::TEXT;
+                } else if (string(optarg) == "binary") {
+                    fileType = FileType::BINARY;
+                } else {
+                    cerr << "Неизвестный тип данных: " << optarg << endl;
+                    return 2;
+                }
+                break;
+            case 'i':
+                inputFile = optarg;
+                break;
+            case 'o':
+                outputFile = optarg;
+                break;
+            case 'j': {
+                uint64_t threads;
+                if (!parseNumber(optarg, UINT_MAX, threads)) {
+                    cerr << "Недопустимое число потоков: " << optarg << endl;
+                    return 2;
+                }
+                cipherThreads = static_cast<unsigned>(threads);
+                break;
+            }
+            case 'M':
+                useMappedFiles = false;
+                break;
+            case 'P':
+                usePipeline = false;
+                break;
+            case 'b':
+                batchDir = optarg;
+                break;
+            case 'U':
+                useUring = true;
+                break;
+            case 'S':
+                if (!optarg || string(optarg) == "text") {
+                    statsFormat = StatsFormat::TEXT;
+                } else if (string(optarg) == "json") {
+                    statsFormat = StatsFormat::JSON;
+                } else {
+                    cerr << "Неизвестный формат статистики: " << optarg << endl;
+                    return 2;
+                }
+                break;
+            case 'C':
+                useContainer = true;
+                break;
+            case 'O':
+            case 'L':
+                if (!parseNumber(optarg, UINT64_MAX, opt == 'O' ? rangeOffset : rangeLength)) {
+                    cerr << "Недопустимое значение " << (opt == 'O' ? "--offset" : "--length") << ": " << optarg << endl;
+                    return 2;
+                }
+                hasRange = true;
+                break;
+            case 'Z': {
+                uint64_t chunkSize;
+                if (!parseNumber(optarg, CONTAINER_MAX_CHUNK_SIZE, chunkSize) || chunkSize == 0) {
+                    cerr << "Недопустимый размер блока: " << optarg << endl;
+                    return 2;
+                }
+                containerChunkSize = static_cast<size_t>(chunkSize);
+                break;
+            }
+            case 'h':
+                printUsage(argv[0]);
+                return 0;
+            default:
+                printUsage(argv[0]);
+                return 2;
+        }
+    }
+    
+    //в пакетном режиме оставшиеся аргументы - входные файлы
+    bool batchMode = !batchDir.empty();
+    if (!hasCipher || direction == 0 || !hasKey || (batchMode ? optind == argc : optind < argc)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    if (useContainer && (fileType != FileType::BINARY || batchMode)) {
+        cerr << "Формат контейнера поддерживается только для бинарных данных вне пакетного режима" << endl;
+        return 2;
+    }
+    if (hasRange && (fileType != FileType::BINARY || batchMode || useContainer)) {
+        cerr << "Диапазон задаётся только для бинарных данных вне пакетного режима и контейнера" << endl;
+        return 2;
+    }
+    
+    //счётчики включаются до загрузки библиотек, чтобы учесть и её
+    if (statsFormat != StatsFormat::NONE) enableMetrics(nullptr);
+    CipherRegistry registry;
+    loadCipherRegistry(registry);
+    if (statsFormat != StatsFormat::NONE) enableMetrics(&registry);
+    string loadError;
+    const CipherFunctions* found = findCipher(registry, method, loadError);
+    if (!found) {
+        cerr << loadError << endl;
+        cerr << "ОШИБКА: Данный шифр недоступен. Библиотека не найдена или повреждена." << endl;
+        unloadCipherRegistry(registry);
+        return 1;
+    }
+    const CipherFunctions& cipherFuncs = *found;
+    
+    bool decrypt = direction < 0;
+    bool binary = fileType == FileType::BINARY;
+    int inFd = -1;
+    int outFd = -1;
+    int status = 0;
+    
+    if (batchMode) {
+        try {
+            status = transformFileBatch(vector<string>(argv + optind, argv + argc), batchDir, key, decrypt, binary, cipherFuncs);
+        } catch (const exception& e) {
+            cerr << "Ошибка: " << e.what() << endl;
+            status = 1;
+        }
+        if (statsFormat != StatsFormat::NONE) printStats(registry, statsFormat);
+        unloadCipherRegistry(registry);
+        return status;
+    }
+    
+    try {
+        //файлы на диске обрабатываем обычным файловым путём (бинарные - с
+        //отображением в память); он же умеет писать результат поверх входа
+        if (!useContainer && !hasRange && inputFile != "-" && outputFile != "-") {
+            if (!binary) {
+                transformTextFile(inputFile, outputFile, key, decrypt, cipherFuncs);
+            } else if (decrypt) {
+                decryptBinaryFile(inputFile, outputFile, key, cipherFuncs);
+            } else {
+                encryptBinaryFile(inputFile, outputFile, key, cipherFuncs);
+            }
+        } else {
+            //выход открывается с обрезкой раньше, чем прочитан вход
+            if (inputFile != "-" && outputFile != "-" && isSameFile(inputFile, outputFile)) {
+                throw runtime_error("Входной и выходной файлы совпадают: " + inputFile);
+            }
+            inFd = inputFile == "-" ? STDIN_FILENO : open(inputFile.c_str(), O_RDONLY);
+            if (inFd < 0) throw runtime_error("Не удалось открыть файл " + inputFile);
+            outFd = outputFile == "-" ? STDOUT_FILENO : open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (outFd < 0) throw runtime_error("Не удалось создать файл " + outputFile);
+            
+            ScopedMetric metric(programMetrics(), PROGRAM_METRIC_FILE, 0);
+            if (useContainer) {
+                transformContainer(inFd, outFd, key, method, decrypt, cipherFuncs);
+            } else if (hasRange) {
+                transformFileRange(inFd, outFd, key, rangeOffset, rangeLength, decrypt, cipherFuncs);
+            } else if (!binary) {
+                transformTextStream(inFd, outFd, key, decrypt, cipherFuncs);
+            } else {
+                streamWithContext(inFd, outFd, key, decrypt, binary, cipherFuncs);
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "Ошибка: " << e.what() << endl;
+        status = 1;
+    }
+    
+    if (inFd > STDIN_FILENO) close(inFd);
+    if (outFd > STDOUT_FILENO && close(outFd) != 0 && status == 0) {
+        cerr << "Ошибка: не удалось записать файл " << outputFile << endl;
+        status = 1;
+    }
+    
+    if (statsFormat != StatsFormat::NONE) printStats(registry, statsFormat);
+    unloadCipherRegistry(registry);
+    return status;
+}
+
+int main(int argc, char* argv[]) {
+    //с параметрами работаем без меню
+    if (argc > 1) {
+        return runCommandLine(argc, argv);
+    }
+    
     cout << "=== КРИПТОГРАФИЧЕСКАЯ СИСТЕМА ===" << endl;
     cout << "Проверка компонентов..." << endl;
     
+    //библиотеки загружаются один раз и остаются загруженными до выхода
+    CipherRegistry registry;
+    loadCipherRegistry(registry);
+    
     while(true) {
         cout << "\n=== КРИПТОГРАФИЧЕСКАЯ СИСТЕМА ===" << endl;
         cout << "0 - Выход\n";
@@ -317,14 +1352,17 @@ int main() {
         
         CipherMethod cipher = static_cast<CipherMethod>(cipherInput);
 
-        //загружаем библиотеку выбранного шифра
-        CipherFunctions cipherFuncs = loadCipherLibrary(cipher);
+        //берём функции выбранного шифра из реестра
+        string loadError;
+        const CipherFunctions* found = findCipher(registry, cipher, loadError);
         
-        if (!cipherFuncs.encryptText || !cipherFuncs.decryptText) {
+        if (!found) {
+            cerr << loadError << endl;
             cout << "ОШИБКА: Данный шифр недоступен. Библиотека не найдена или повреждена." << endl;;
             cout << "Убедитесь, что файл библиотеки присутствует в текущей директории." << endl;
             continue;
         }
+        const CipherFunctions& cipherFuncs = *found;
 
         //ввод ключа
         cout << "Введите ключ: "; 
@@ -413,11 +1451,9 @@ int main() {
         } catch (const exception& e) { 
             cout << "Ошибка: " << e.what() << endl; 
         }
-        
-        //выгружаем библиотеку после использования
-        unloadCipherLibrary(cipherFuncs);
     }
     
+    unloadCipherRegistry(registry);
     cout << "Выход из программы." << endl;;
     return 0;
 }
\ No newline at end of file
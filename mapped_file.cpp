@@ -0,0 +1,91 @@
+#include "mapped_file.h"
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+MappedInput::~MappedInput() {
+    if (data) munmap(data, size);
+    if (fd >= 0) close(fd);
+}
+
+MappedOutput::~MappedOutput() {
+    if (data) munmap(data, size);
+    if (fd >= 0) close(fd);
+}
+
+bool mapInputFile(const string& path, MappedInput& input, bool writable) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Не удалось открыть файл " + path);
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    
+    int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* addr = mmap(nullptr, st.st_size, protection, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    
+    //данные читаются один раз подряд
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    
+    input.fd = fd;
+    input.data = static_cast<char*>(addr);
+    input.size = st.st_size;
+    return true;
+}
+
+void releaseMappedRange(MappedInput& input, size_t offset, size_t length) {
+    //границы выравниваются внутрь диапазона, чтобы не задеть соседние данные
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = offset + length == input.size ? input.size : (offset + length) / page * page;
+    if (begin < end) {
+        madvise(input.data + begin, end - begin, MADV_DONTNEED);
+    }
+}
+
+void mapOutputFile(const string& path, size_t size, MappedOutput& output) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw runtime_error("Не удалось создать файл " + path);
+    }
+    output.fd = fd;
+    
+    if (ftruncate(fd, size) != 0) {
+        throw runtime_error("Не удалось задать размер файла " + path + ": " + strerror(errno));
+    }
+    if (size == 0) return;
+    
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        throw runtime_error("Не удалось отобразить файл " + path + ": " + strerror(errno));
+    }
+    madvise(addr, size, MADV_SEQUENTIAL);
+    
+    output.data = static_cast<char*>(addr);
+    output.size = size;
+}
+
+void finishOutputFile(MappedOutput& output, size_t finalSize) {
+    if (output.data) {
+        munmap(output.data, output.size);
+        output.data = nullptr;
+    }
+    if (finalSize != output.size && ftruncate(output.fd, finalSize) != 0) {
+        throw runtime_error(string("Не удалось обрезать выходной файл: ") + strerror(errno));
+    }
+    output.size = 0;
+}
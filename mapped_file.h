@@ -0,0 +1,54 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+//входной файл, отображённый в память. Изменять data можно только при
+//отображении с writable == true: изменения остаются в памяти процесса
+//и не попадают в файл
+struct MappedInput {
+    int fd;
+    char* data;
+    size_t size;
+    
+    MappedInput() : fd(-1), data(nullptr), size(0) {}
+    ~MappedInput();
+    
+    MappedInput(const MappedInput&) = delete;
+    MappedInput& operator=(const MappedInput&) = delete;
+};
+
+//выходной файл заранее заданного размера, отображённый в память для записи
+struct MappedOutput {
+    int fd;
+    char* data;
+    size_t size;
+    
+    MappedOutput() : fd(-1), data(nullptr), size(0) {}
+    ~MappedOutput();
+    
+    MappedOutput(const MappedOutput&) = delete;
+    MappedOutput& operator=(const MappedOutput&) = delete;
+};
+
+//отображает входной файл. Возвращает false, если файл нельзя отобразить
+//(не обычный файл или пустой) - тогда нужно использовать потоковый путь.
+//writable - частное отображение с правом записи (копирование при записи)
+//для преобразования данных на месте
+bool mapInputFile(const string& path, MappedInput& input, bool writable = false);
+
+//диапазон входа больше не нужен: его страницы (и их изменённые копии)
+//освобождаются, при повторном чтении данные снова берутся из файла
+void releaseMappedRange(MappedInput& input, size_t offset, size_t length);
+
+//создаёт выходной файл размера size (ftruncate) и отображает его. Прежнее
+//содержимое теряется, поэтому выход не должен совпадать с отображённым входом
+void mapOutputFile(const string& path, size_t size, MappedOutput& output);
+
+//снимает отображение и обрезает выходной файл до фактического размера
+void finishOutputFile(MappedOutput& output, size_t finalSize);
+
+#endif
@@ -0,0 +1,219 @@
+#include "metrics.h"
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+using namespace std;
+
+//число копий счётчиков, закрепляемых за отдельными потоками; одновременно
+//работающих потоков обычно не больше числа ядер. Потоки сверх этого числа
+//пишут в общую копию с номером METRICS_SHARDS
+const size_t METRICS_SHARDS = 16;
+
+//счётчиков в строке кэша
+const size_t COUNTERS_PER_CACHE_LINE = 64 / sizeof(atomic<uint64_t>);
+
+static mutex shardGuard;
+static uint32_t leasedShards = 0;      //битовая маска занятых копий
+
+//копия счётчиков, закреплённая за потоком на время его жизни. Закреплённую
+//копию обновляет только её поток, поэтому ему не нужны атомарные операции
+//чтения-изменения-записи; после завершения потока копия (со всеми
+//накопленными значениями) переходит к следующему
+class ShardLease {
+public:
+    ShardLease() : index(METRICS_SHARDS) {
+        lock_guard<mutex> lock(shardGuard);
+        for (size_t i = 0; i < METRICS_SHARDS; i++) {
+            if (!(leasedShards & (1u << i))) {
+                leasedShards |= 1u << i;
+                index = i;
+                break;
+            }
+        }
+    }
+    
+    ~ShardLease() {
+        if (index == METRICS_SHARDS) return;
+        lock_guard<mutex> lock(shardGuard);
+        leasedShards &= ~(1u << index);
+    }
+    
+    size_t index;
+};
+
+static size_t threadShard() {
+    static thread_local ShardLease lease;
+    return lease.index;
+}
+
+size_t latencyBucket(uint64_t nanoseconds) {
+    if (nanoseconds == 0) return 0;
+    size_t bucket = 63 - __builtin_clzll(nanoseconds);
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+uint64_t OperationMetrics::latencyPercentile(double fraction) const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) total += latency[i];
+    if (total == 0) return 0;
+    
+    uint64_t target = static_cast<uint64_t>(fraction * total);
+    if (target == 0) target = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += latency[i];
+        if (seen >= target) return uint64_t(1) << (i + 1);
+    }
+    return uint64_t(1) << LATENCY_BUCKETS;
+}
+
+MetricsRegistry::MetricsRegistry(size_t operations)
+    : operations(operations),
+      shardStride((operations * FIELD_COUNT + COUNTERS_PER_CACHE_LINE - 1) / COUNTERS_PER_CACHE_LINE * COUNTERS_PER_CACHE_LINE),
+      counters(new atomic<uint64_t>[(METRICS_SHARDS + 1) * shardStride]()), active(false), allocationCounter(nullptr) {}
+
+void MetricsRegistry::record(size_t operation, uint64_t bytes, uint64_t nanoseconds, uint64_t allocations) {
+    if (operation >= operations) return;
+    
+    size_t shard = threadShard();
+    bool owned = shard < METRICS_SHARDS;
+    auto add = [&](size_t field, uint64_t value) {
+        atomic<uint64_t>& target = counter(shard, operation, field);
+        if (owned) {
+            target.store(target.load(memory_order_relaxed) + value, memory_order_relaxed);
+        } else {
+            target.fetch_add(value, memory_order_relaxed);
+        }
+    };
+    
+    add(CALLS, 1);
+    add(BYTES, bytes);
+    add(NANOSECONDS, nanoseconds);
+    if (allocations) add(ALLOCATIONS, allocations);
+    add(LATENCY + latencyBucket(nanoseconds), 1);
+}
+
+vector<OperationMetrics> MetricsRegistry::snapshot() const {
+    vector<OperationMetrics> result(operations);
+    for (size_t shard = 0; shard <= METRICS_SHARDS; shard++) {
+        for (size_t operation = 0; operation < operations; operation++) {
+            OperationMetrics& total = result[operation];
+            total.calls += counter(shard, operation, CALLS).load(memory_order_relaxed);
+            total.bytes += counter(shard, operation, BYTES).load(memory_order_relaxed);
+            total.nanoseconds += counter(shard, operation, NANOSECONDS).load(memory_order_relaxed);
+            total.allocations += counter(shard, operation, ALLOCATIONS).load(memory_order_relaxed);
+            for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+                total.latency[i] += counter(shard, operation, LATENCY + i).load(memory_order_relaxed);
+            }
+        }
+    }
+    return result;
+}
+
+void MetricsRegistry::snapshot(CipherMetrics* metrics) const {
+    vector<OperationMetrics> totals = snapshot();
+    for (size_t operation = 0; operation < CIPHER_METRIC_OPERATIONS; operation++) {
+        CipherOperationMetrics& target = metrics->operations[operation];
+        OperationMetrics source = operation < totals.size() ? totals[operation] : OperationMetrics();
+        target.calls = source.calls;
+        target.bytes = source.bytes;
+        target.nanoseconds = source.nanoseconds;
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            target.latency[i] = source.latency[i];
+        }
+    }
+}
+
+const char* const CIPHER_METRIC_NAMES[CIPHER_METRIC_OPERATIONS] = {
+    "encrypt_text",
+    "decrypt_text",
+    "encrypt_binary",
+    "decrypt_binary"
+};
+
+vector<OperationMetrics> cipherOperationMetrics(const CipherMetrics& metrics) {
+    vector<OperationMetrics> result(CIPHER_METRIC_OPERATIONS);
+    for (size_t operation = 0; operation < CIPHER_METRIC_OPERATIONS; operation++) {
+        const CipherOperationMetrics& source = metrics.operations[operation];
+        result[operation].calls = source.calls;
+        result[operation].bytes = source.bytes;
+        result[operation].nanoseconds = source.nanoseconds;
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            result[operation].latency[i] = source.latency[i];
+        }
+    }
+    return result;
+}
+
+//время в удобных единицах для таблицы
+static string formatNanoseconds(uint64_t nanoseconds) {
+    ostringstream text;
+    text << fixed << setprecision(1);
+    if (nanoseconds < 10000) {
+        text << nanoseconds << " нс";
+    } else if (nanoseconds < 10000000) {
+        text << nanoseconds / 1e3 << " мкс";
+    } else if (nanoseconds < 10000000000ull) {
+        text << nanoseconds / 1e6 << " мс";
+    } else {
+        text << nanoseconds / 1e9 << " с";
+    }
+    return text.str();
+}
+
+void printMetricsText(ostream& out, const string& title, const vector<string>& names,
+                      const vector<OperationMetrics>& metrics) {
+    out << title << ":\n";
+    bool any = false;
+    for (size_t i = 0; i < metrics.size() && i < names.size(); i++) {
+        const OperationMetrics& m = metrics[i];
+        if (m.calls == 0) continue;
+        any = true;
+        
+        double seconds = m.nanoseconds / 1e9;
+        out << "  " << left << setw(16) << names[i] << right
+            << " вызовов " << setw(8) << m.calls
+            << "  байт " << setw(12) << m.bytes
+            << "  время " << setw(10) << formatNanoseconds(m.nanoseconds);
+        if (m.bytes > 0 && seconds > 0) {
+            out << "  " << setw(8) << fixed << setprecision(1) << m.bytes / seconds / (1 << 20) << " МБ/с";
+        }
+        out << "  p50 ≤ " << formatNanoseconds(m.latencyPercentile(0.5))
+            << "  p99 ≤ " << formatNanoseconds(m.latencyPercentile(0.99));
+        if (m.allocations > 0) {
+            out << "  выделений на вызов " << fixed << setprecision(1) << static_cast<double>(m.allocations) / m.calls;
+        }
+        out << '\n';
+    }
+    if (!any) out << "  нет вызовов\n";
+}
+
+void printMetricsJson(ostream& out, const vector<string>& names, const vector<OperationMetrics>& metrics) {
+    out << '{';
+    bool first = true;
+    for (size_t i = 0; i < metrics.size() && i < names.size(); i++) {
+        const OperationMetrics& m = metrics[i];
+        if (m.calls == 0) continue;
+        if (!first) out << ", ";
+        first = false;
+        
+        out << '"' << names[i] << "\": {\"calls\": " << m.calls
+            << ", \"bytes\": " << m.bytes
+            << ", \"nanoseconds\": " << m.nanoseconds
+            << ", \"allocations\": " << m.allocations
+            << ", \"p50_ns\": " << m.latencyPercentile(0.5)
+            << ", \"p99_ns\": " << m.latencyPercentile(0.99)
+            << ", \"latency_ns\": [";
+        //непустые корзины парами [верхняя граница, число вызовов]
+        bool firstBucket = true;
+        for (size_t b = 0; b < LATENCY_BUCKETS; b++) {
+            if (m.latency[b] == 0) continue;
+            if (!firstBucket) out << ", ";
+            firstBucket = false;
+            out << '[' << (uint64_t(1) << (b + 1)) << ", " << m.latency[b] << ']';
+        }
+        out << "]}";
+    }
+    out << '}';
+}
@@ -0,0 +1,131 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "cipher_plugin.h"
+
+using namespace std;
+
+//число корзин гистограммы задержек (см. CIPHER_LATENCY_BUCKETS)
+const size_t LATENCY_BUCKETS = CIPHER_LATENCY_BUCKETS;
+
+//корзина гистограммы для вызова длительностью nanoseconds
+size_t latencyBucket(uint64_t nanoseconds);
+
+//итоговые значения счётчиков одной операции
+struct OperationMetrics {
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t nanoseconds;
+    uint64_t allocations;       //выделений памяти за время вызовов (0, если не считаются)
+    uint64_t latency[LATENCY_BUCKETS];
+    
+    OperationMetrics() : calls(0), bytes(0), nanoseconds(0), allocations(0), latency() {}
+    
+    //оценка задержки, которую не превышает доля fraction вызовов:
+    //верхняя граница соответствующей корзины, нс
+    uint64_t latencyPercentile(double fraction) const;
+};
+
+//набор счётчиков операций с гистограммами задержек. У каждого потока своя
+//копия счётчиков, поэтому потоки не делят строки кэша и не ждут друг друга;
+//при чтении копии складываются. Сбор включается setEnabled, выключенный
+//набор стоит вызывающему одну проверку флага
+class MetricsRegistry {
+public:
+    explicit MetricsRegistry(size_t operations);
+    
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+    
+    bool enabled() const { return active.load(memory_order_relaxed); }
+    void setEnabled(bool value) { active.store(value, memory_order_relaxed); }
+    
+    //счётчик выделений памяти текущего потока; задаёт программа,
+    //которая их считает (библиотеки шифров этого не делают)
+    void setAllocationCounter(uint64_t (*counter)()) { allocationCounter = counter; }
+    uint64_t allocationCount() const { return allocationCounter ? allocationCounter() : 0; }
+    
+    void record(size_t operation, uint64_t bytes, uint64_t nanoseconds, uint64_t allocations);
+    
+    //сумма по всем потокам, элемент на операцию
+    vector<OperationMetrics> snapshot() const;
+    
+    //то же в терминах интерфейса плагинов (для наборов из CIPHER_METRIC_OPERATIONS операций)
+    void snapshot(CipherMetrics* metrics) const;
+
+private:
+    //поля счётчиков одной операции в шарде
+    enum Field { CALLS, BYTES, NANOSECONDS, ALLOCATIONS, LATENCY, FIELD_COUNT = LATENCY + LATENCY_BUCKETS };
+    
+    atomic<uint64_t>& counter(size_t shard, size_t operation, size_t field) const {
+        return counters[shard * shardStride + operation * FIELD_COUNT + field];
+    }
+    
+    size_t operations;
+    size_t shardStride;         //счётчиков в шарде, кратно строке кэша
+    unique_ptr<atomic<uint64_t>[]> counters;
+    atomic<bool> active;
+    uint64_t (*allocationCounter)();
+};
+
+//замер одного вызова: время от создания до разрушения объекта попадает
+//в счётчики операции. При выключенном наборе ничего не замеряется
+class ScopedMetric {
+public:
+    ScopedMetric(MetricsRegistry& registry, size_t operation, uint64_t bytes)
+        : registry(registry.enabled() ? &registry : nullptr), operation(operation), bytes(bytes), allocations(0) {
+        if (this->registry) {
+            allocations = registry.allocationCount();
+            start = chrono::steady_clock::now();
+        }
+    }
+    
+    ScopedMetric(const ScopedMetric&) = delete;
+    ScopedMetric& operator=(const ScopedMetric&) = delete;
+    
+    ~ScopedMetric() {
+        if (!registry) return;
+        uint64_t elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        registry->record(operation, bytes, elapsed, registry->allocationCount() - allocations);
+    }
+    
+    //объём, известный только после операции (например, прочитанные байты)
+    void setBytes(uint64_t value) { bytes = value; }
+
+private:
+    MetricsRegistry* registry;
+    size_t operation;
+    uint64_t bytes;
+    uint64_t allocations;
+    chrono::steady_clock::time_point start;
+};
+
+//операция шифра для направления и типа данных
+inline size_t cipherMetricOperation(bool decrypt, bool binary) {
+    return binary ? (decrypt ? CIPHER_METRIC_DECRYPT_BINARY : CIPHER_METRIC_ENCRYPT_BINARY)
+                  : (decrypt ? CIPHER_METRIC_DECRYPT_TEXT : CIPHER_METRIC_ENCRYPT_TEXT);
+}
+
+//названия операций шифра для отчётов
+extern const char* const CIPHER_METRIC_NAMES[CIPHER_METRIC_OPERATIONS];
+
+//счётчики шифра из интерфейса плагинов
+vector<OperationMetrics> cipherOperationMetrics(const CipherMetrics& metrics);
+
+//отчёт в виде таблицы: строка на каждую операцию, которая вызывалась
+void printMetricsText(ostream& out, const string& title, const vector<string>& names,
+                      const vector<OperationMetrics>& metrics);
+
+//отчёт в виде объекта JSON {"операция": {...}, ...} (без перевода строки в конце)
+void printMetricsJson(ostream& out, const vector<string>& names, const vector<OperationMetrics>& metrics);
+
+#endif
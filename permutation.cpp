@@ -1,10 +1,16 @@
 #include "permutation.h"
 #include "utils.h"
+#include "thread_pool.h"
+#include "plugin_support.h"
+#include "key_cache.h"
+#include "metrics.h"
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <utility>
 #include <cctype>
+#include <memory>
+#include <stdexcept>
 
 using namespace std;
 
@@ -38,47 +44,149 @@ vector<int> createColumnOrder(const vector<int>& numericKey) {
     return columnOrder;
 }
 
-//шифрование бинарных данных
-string encryptPermutationBinary(const string& data, const string& key) {
-    if (data.empty() || key.empty()) return data;
+//номера исходных столбцов в порядке чтения (обратная перестановка к columnOrder)
+static vector<int> invertColumnOrder(const vector<int>& columnOrder) {
+    vector<int> sourceColumn(columnOrder.size());
+    for (size_t i = 0; i < columnOrder.size(); i++) {
+        sourceColumn[columnOrder[i]] = i;
+    }
+    return sourceColumn;
+}
+
+//скомпилированный ключ: порядок столбцов и обратная к нему перестановка
+struct PermutationKey {
+    vector<int> columnOrder;
+    vector<int> sourceColumn;
+};
+
+static PermutationKey makePermutationKey(vector<int> columnOrder) {
+    PermutationKey key;
+    key.sourceColumn = invertColumnOrder(columnOrder);
+    key.columnOrder = move(columnOrder);
+    return key;
+}
+
+//кэши ключей бинарного и текстового режимов (ключи разбираются по-разному)
+static KeyCache<PermutationKey> binaryKeyCache;
+static KeyCache<PermutationKey> textKeyCache;
+
+//ключ бинарного режима из кэша
+static shared_ptr<const PermutationKey> binaryKey(const string& key) {
+    return binaryKeyCache.get(key, [](const string& text) {
+        return makePermutationKey(createColumnOrder(getNumericKey(text)));
+    });
+}
+
+//размеры блока при перестановке: блок из TILE_ROWS строк и TILE_COLS столбцов
+//помещается в L1/L2, так что и чтение, и запись идут по горячим строкам кэша
+static const size_t TILE_BYTES = 16 * 1024;
+static const size_t TILE_COLS = 64;
+
+//настройки параллельной обработки
+static ParallelSettings parallelSettings;
+
+//счётчики вызовов по операциям (CipherMetricOperation)
+static MetricsRegistry callMetrics(CIPHER_METRIC_OPERATIONS);
+
+//перестановка полных строк [firstRow, lastRow) без промежуточной таблицы.
+//При шифровании столбец sourceColumn[rank] входа становится отрезком
+//out[rank * totalRows ...], при дешифровании - наоборот
+static void transposeTiled(const char* data, char* out, size_t firstRow, size_t lastRow, size_t totalRows, size_t cols,
+                           const vector<int>& sourceColumn, bool decrypt) {
+    size_t tileCols = min(cols, TILE_COLS);
+    size_t tileRows = max(TILE_COLS, TILE_BYTES / tileCols);
+    
+    for (size_t rowStart = firstRow; rowStart < lastRow; rowStart += tileRows) {
+        size_t rowEnd = min(lastRow, rowStart + tileRows);
+        
+        for (size_t rankStart = 0; rankStart < cols; rankStart += tileCols) {
+            size_t rankEnd = min(cols, rankStart + tileCols);
+            
+            for (size_t rank = rankStart; rank < rankEnd; rank++) {
+                size_t originalCol = sourceColumn[rank];
+                if (decrypt) {
+                    const char* column = data + rank * totalRows;
+                    for (size_t i = rowStart; i < rowEnd; i++) {
+                        out[i * cols + originalCol] = column[i];
+                    }
+                } else {
+                    char* column = out + rank * totalRows;
+                    for (size_t i = rowStart; i < rowEnd; i++) {
+                        column[i] = data[i * cols + originalCol];
+                    }
+                }
+            }
+        }
+    }
+}
+
+//перестановка полных строк [0, rows), распределённая по потокам. Каждый поток
+//берёт свой диапазон строк: при шифровании он пишет в свои отрезки каждого
+//столбца результата, при дешифровании - в свои строки, так что записи потоков
+//не пересекаются и результат совпадает с последовательным
+static void transposeParallel(const char* data, char* out, size_t rows, size_t totalRows, size_t cols,
+                              const vector<int>& sourceColumn, bool decrypt) {
+    ParallelSettings rowSettings = parallelSettings;
+    rowSettings.minBytes = max<size_t>(1, parallelSettings.minBytes / cols);
+    
+    parallelRanges(rows, rowSettings, [&](size_t begin, size_t end) {
+        transposeTiled(data, out, begin, end, totalRows, cols, sourceColumn, decrypt);
+    });
+}
+
+//шифрование бинарных данных с готовым порядком столбцов в буфер размера rows * cols
+static size_t encryptPermutationBinaryWithOrder(const char* data, size_t length, const PermutationKey& key, char* out) {
+    size_t cols = key.columnOrder.size();
+    size_t rows = (length + cols - 1) / cols;
+    size_t fullRows = length / cols;
+    const vector<int>& sourceColumn = key.sourceColumn;
+    
+    transposeParallel(data, out, fullRows, rows, cols, sourceColumn, false);
+    
+    //неполная последняя строка дополняется нулями
+    if (fullRows < rows) {
+        for (size_t rank = 0; rank < cols; rank++) {
+            size_t index = fullRows * cols + sourceColumn[rank];
+            out[rank * rows + fullRows] = index < length ? data[index] : 0;
+        }
+    }
     
-    vector<int> numericKey = getNumericKey(key);
-    vector<int> columnOrder = createColumnOrder(numericKey);
+    return rows * cols;
+}
+
+//дешифрование бинарных данных с готовым порядком столбцов в буфер размера length
+static size_t decryptPermutationBinaryWithOrder(const char* data, size_t length, const PermutationKey& key, char* out) {
+    size_t cols = key.columnOrder.size();
+    size_t rows = length / cols;
     
-    int cols = numericKey.size();
-    int rows = (data.length() + cols - 1) / cols;
+    if (rows * cols != length) {
+        throw invalid_argument("Некорректная длина зашифрованных данных");
+    }
     
-    //создаем таблицу
-    vector<vector<char>> table(rows, vector<char>(cols, 0));
+    transposeParallel(data, out, rows, rows, cols, key.sourceColumn, true);
     
-    //заполняем таблицу
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            size_t index = i * cols + j;
-            if (index < data.length()) {
-                table[i][j] = data[index];
-            } else {
-                table[i][j] = 0; //заполнитель
-            }
-        }
+    //удаляем нулевые байты в конце
+    size_t resultLength = length;
+    while (resultLength > 0 && out[resultLength - 1] == 0) {
+        resultLength--;
     }
     
-    //читаем по столбцам в порядке ключа
-    string result;
-    for (int colIndex = 0; colIndex < cols; colIndex++) {
-        int originalCol = -1;
-        for (int i = 0; i < cols; i++) {
-            if (columnOrder[i] == colIndex) {
-                originalCol = i;
-                break;
-            }
-        }
-        
-        for (int i = 0; i < rows; i++) {
-            result += table[i][originalCol];
-        }
+    return resultLength;
+}
+
+//проверка размера буфера вызывающего
+static void checkOutputCapacity(size_t required, size_t outCapacity) {
+    if (outCapacity < required) {
+        throw length_error("Недостаточный размер выходного буфера");
     }
+}
+
+//шифрование бинарных данных
+string encryptPermutationBinary(const string& data, const string& key) {
+    if (data.empty() || key.empty()) return data;
     
+    string result(permutationOutputSize(data.size(), key, false, true), '\0');
+    result.resize(encryptPermutationBinaryInto(data.data(), data.size(), key, &result[0], result.size()));
     return result;
 }
 
@@ -86,95 +194,88 @@ string encryptPermutationBinary(const string& data, const string& key) {
 string decryptPermutationBinary(const string& data, const string& key) {
     if (data.empty() || key.empty()) return data;
     
-    vector<int> numericKey = getNumericKey(key);
-    vector<int> columnOrder = createColumnOrder(numericKey);
-    
-    int cols = numericKey.size();
-    int rows = data.length() / cols;
-    
-    if (rows * cols != data.length()) {
-        throw ("Некорректная длина зашифрованных данных");
+    string result(permutationOutputSize(data.size(), key, true, true), '\0');
+    result.resize(decryptPermutationBinaryInto(data.data(), data.size(), key, &result[0], result.size()));
+    return result;
+}
+
+//бинарное шифрование в буфер вызывающего
+size_t encryptPermutationBinaryInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_ENCRYPT_BINARY, length);
+    checkOutputCapacity(permutationOutputSize(length, key, false, true), outCapacity);
+    if (length == 0 || key.empty()) {
+        copy(data, data + length, out);
+        return length;
     }
     
-    //создаем таблицу для записи
-    vector<vector<char>> table(rows, vector<char>(cols, 0));
-    
-    //заполняем таблицу по столбцам в порядке ключа
-    size_t dataIndex = 0;
-    for (int colIndex = 0; colIndex < cols; colIndex++) {
-        int originalCol = -1;
-        for (int i = 0; i < cols; i++) {
-            if (columnOrder[i] == colIndex) {
-                originalCol = i;
-                break;
-            }
-        }
-        
-        for (int i = 0; i < rows; i++) {
-            if (dataIndex < data.length()) {
-                table[i][originalCol] = data[dataIndex++];
-            }
-        }
+    return encryptPermutationBinaryWithOrder(data, length, *binaryKey(key), out);
+}
+
+//бинарное дешифрование в буфер вызывающего
+size_t decryptPermutationBinaryInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_DECRYPT_BINARY, length);
+    checkOutputCapacity(permutationOutputSize(length, key, true, true), outCapacity);
+    if (length == 0 || key.empty()) {
+        copy(data, data + length, out);
+        return length;
     }
     
-    //читаем построчно
-    string result;
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            if (i * cols + j < data.length()) {
-                result += table[i][j];
-            }
-        }
+    return decryptPermutationBinaryWithOrder(data, length, *binaryKey(key), out);
+}
+
+//символ текста как одно число: байт ASCII (0-255) или кириллическая пара
+//UTF-8 (первый байт << 8 | второй байт). Целые коды сравниваются так же,
+//как соответствующие строки UTF-8
+typedef unsigned short CodeUnit;
+
+static const CodeUnit UNIT_UNDERSCORE = '_';
+
+//считывает очередной символ с позиции index (как getCharAt, но без выделения памяти)
+static inline CodeUnit readCodeUnit(const char* text, size_t length, size_t& index) {
+    unsigned char lead = static_cast<unsigned char>(text[index]);
+    if ((lead == 0xD0 || lead == 0xD1) && index + 1 < length) {
+        CodeUnit unit = static_cast<CodeUnit>(lead << 8 | static_cast<unsigned char>(text[index + 1]));
+        index += 2;
+        return unit;
     }
-    
-    //удаляем нулевые байты в конце
-    while (!result.empty() && result.back() == 0) {
-        result.pop_back();
+    index++;
+    return lead;
+}
+
+//записывает символ в буфер, возвращает число записанных байт
+static inline size_t writeCodeUnit(CodeUnit unit, char* out) {
+    if (unit > 0xFF) {
+        out[0] = static_cast<char>(unit >> 8);
+        out[1] = static_cast<char>(unit & 0xFF);
+        return 2;
     }
-    
-    return result;
+    out[0] = static_cast<char>(unit);
+    return 1;
 }
 
-//шифрование текста
-string encryptPermutationText(const string& text, const string& key) {
-    if (text.empty()) return "";
-    
-    string processed = replaceSpacesWithUnderscores(text);
-    string upperKey;
+//число байт символа в UTF-8
+static inline size_t codeUnitSize(CodeUnit unit) {
+    return unit > 0xFF ? 2 : 1;
+}
+
+//порядок столбцов для текстового режима (пустой, если в ключе нет букв).
+//Латинские буквы ключа приводятся к верхнему регистру, остальные символы,
+//кроме кириллицы, пропускаются
+static vector<int> createTextColumnOrder(const string& key) {
+    vector<pair<int, int>> keyWithIndex;
     
-    //парсируем ключ
     for (size_t i = 0; i < key.length(); ) {
-        if (isCyrillicUTF8(key, i)) {
-            upperKey += key[i];
-            upperKey += key[i + 1];
-            i += 2;
-        } else if (isalpha(key[i])) {
-            upperKey += toupper(key[i]);
-            i++;
-        } else {
-            i++;
-        }
-    }
-    
-    if (upperKey.empty()) return processed;
-
-    //создаем порядок столбцов
-    vector<pair<string, int>> keyWithIndex;
-    for (size_t i = 0; i < upperKey.length(); ) {
-        string keyChar;
-        if (isCyrillicUTF8(upperKey, i)) {
-            keyChar = upperKey.substr(i, 2);
-            keyWithIndex.push_back({keyChar, keyWithIndex.size()});
-            i += 2;
-        } else {
-            keyChar = string(1, upperKey[i]);
-            keyWithIndex.push_back({keyChar, keyWithIndex.size()});
-            i++;
+        size_t start = i;
+        CodeUnit unit = readCodeUnit(key.data(), key.length(), i);
+        if (i - start == 2) {
+            keyWithIndex.push_back({unit, static_cast<int>(keyWithIndex.size())});
+        } else if (isLatin(static_cast<char>(unit))) {
+            keyWithIndex.push_back({toupper(unit), static_cast<int>(keyWithIndex.size())});
         }
     }
     
     sort(keyWithIndex.begin(), keyWithIndex.end(), 
-         [](const pair<string, int>& a, const pair<string, int>& b) {
+         [](const pair<int, int>& a, const pair<int, int>& b) {
              return a.first == b.first ? a.second < b.second : a.first < b.first;
          });
     
@@ -182,121 +283,310 @@ string encryptPermutationText(const string& text, const string& key) {
     for (size_t i = 0; i < keyWithIndex.size(); ++i) {
         columnOrder[keyWithIndex[i].second] = i;
     }
+    
+    return columnOrder;
+}
+
+//ключ текстового режима из кэша
+static shared_ptr<const PermutationKey> textKey(const string& key) {
+    return textKeyCache.get(key, [](const string& text) {
+        return makePermutationKey(createTextColumnOrder(text));
+    });
+}
 
-    int cols = keyWithIndex.size();
-    size_t effectiveLength = countEffectiveChars(processed);
-    int rows = (effectiveLength + cols - 1) / cols;
+//шифрование текста с готовым порядком столбцов в буфер вызывающего.
+//За один проход текст разбирается в плоскую таблицу символов, пробелы
+//заменяются на '_', последняя строка дополняется '_'
+static size_t encryptPermutationTextWithOrder(const char* text, size_t length, const PermutationKey& key,
+                                              char* out, size_t outCapacity) {
+    if (key.columnOrder.empty()) {
+        checkOutputCapacity(length, outCapacity);
+        for (size_t i = 0; i < length; i++) {
+            out[i] = text[i] == ' ' ? '_' : text[i];
+        }
+        return length;
+    }
     
-    //создаем таблицу
-    vector<vector<string>> table(rows, vector<string>(cols, "_"));
+    size_t cols = key.columnOrder.size();
+    vector<CodeUnit> table;
+    table.reserve(length + cols);
     
-    //заполняем таблицу
+    for (size_t i = 0; i < length; ) {
+        CodeUnit unit = readCodeUnit(text, length, i);
+        //пробел заменяется побайтно, в том числе второй байт пары
+        if ((unit & 0xFF) == ' ') unit = (unit & 0xFF00) | UNIT_UNDERSCORE;
+        table.push_back(unit);
+    }
+    
+    size_t units = table.size();
+    size_t rows = (units + cols - 1) / cols;
+    table.resize(rows * cols, UNIT_UNDERSCORE);
+    checkOutputCapacity(length + (rows * cols - units), outCapacity);
+    
+    //читаем по столбцам в порядке ключа
+    size_t written = 0;
+    for (size_t colIndex = 0; colIndex < cols; ++colIndex) {
+        size_t originalCol = key.sourceColumn[colIndex];
+        for (size_t i = 0; i < rows; ++i) {
+            written += writeCodeUnit(table[i * cols + originalCol], out + written);
+        }
+    }
+    
+    return written;
+}
+
+//дешифрование текста с готовым порядком столбцов в буфер вызывающего.
+//Символы шифротекста сразу раскладываются по ячейкам таблицы, затем таблица
+//читается построчно с удалением '_' в конце и заменой '_' на пробелы
+static size_t decryptPermutationTextWithOrder(const char* text, size_t length, const PermutationKey& key,
+                                              char* out, size_t outCapacity) {
+    if (key.columnOrder.empty()) {
+        checkOutputCapacity(length, outCapacity);
+        copy(text, text + length, out);
+        return length;
+    }
+    
+    size_t cols = key.columnOrder.size();
+    size_t units = 0;
+    for (size_t i = 0; i < length; units++) {
+        readCodeUnit(text, length, i);
+    }
+    size_t rows = (units + cols - 1) / cols;
+    
+    //ячейки, на которые не хватило символов, остаются '_'
+    vector<CodeUnit> table(rows * cols, UNIT_UNDERSCORE);
     size_t textIndex = 0;
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            if (textIndex < processed.length()) {
-                table[i][j] = getCharAt(processed, textIndex);
-            }
+    for (size_t colIndex = 0; colIndex < cols && textIndex < length; ++colIndex) {
+        size_t originalCol = key.sourceColumn[colIndex];
+        for (size_t i = 0; i < rows && textIndex < length; ++i) {
+            table[i * cols + originalCol] = readCodeUnit(text, length, textIndex);
         }
     }
     
-    //читаем по столбцам
-    string ciphertext;
-    for (int colIndex = 0; colIndex < cols; ++colIndex) {
-        int originalCol = -1;
-        for (int i = 0; i < cols; ++i) {
-            if (columnOrder[i] == colIndex) {
-                originalCol = i;
-                break;
+    checkOutputCapacity(length + (rows * cols - units), outCapacity);
+    
+    //читаем построчно, запоминая конец последнего байта, отличного от '_'
+    size_t written = 0;
+    size_t lastChar = 0;
+    bool hasChar = false;
+    for (CodeUnit unit : table) {
+        size_t size = writeCodeUnit(unit, out + written);
+        for (size_t j = written; j < written + size; j++) {
+            if (out[j] == '_') {
+                out[j] = ' ';
+            } else {
+                lastChar = j;
+                hasChar = true;
             }
         }
-        
-        for (int i = 0; i < rows; ++i) {
-            ciphertext += table[i][originalCol];
-        }
+        written += size;
     }
     
-    return ciphertext;
+    return hasChar ? lastChar + 1 : written;
+}
+
+//шифрование текста
+string encryptPermutationText(const string& text, const string& key) {
+    if (text.empty()) return "";
+    
+    string result(permutationOutputSize(text.size(), key, false, false), '\0');
+    result.resize(encryptPermutationTextInto(text.data(), text.size(), key, &result[0], result.size()));
+    return result;
 }
 
 //дешифрование текста
 string decryptPermutationText(const string& ciphertext, const string& key) {
     if (ciphertext.empty()) return "";
     
-    string upperKey;
-    for (size_t i = 0; i < key.length(); ) {
-        if (isCyrillicUTF8(key, i)) {
-            upperKey += key[i];
-            upperKey += key[i + 1];
-            i += 2;
-        } else if (isalpha(key[i])) {
-            upperKey += toupper(key[i]);
-            i++;
-        } else {
-            i++;
-        }
-    }
-    
-    if (upperKey.empty()) return ciphertext;
-
-    vector<pair<string, int>> keyWithIndex;
-    for (size_t i = 0; i < upperKey.length(); ) {
-        string keyChar;
-        if (isCyrillicUTF8(upperKey, i)) {
-            keyChar = upperKey.substr(i, 2);
-            keyWithIndex.push_back({keyChar, keyWithIndex.size()});
-            i += 2;
-        } else {
-            keyChar = string(1, upperKey[i]);
-            keyWithIndex.push_back({keyChar, keyWithIndex.size()});
-            i++;
-        }
-    }
+    string result(permutationOutputSize(ciphertext.size(), key, true, false), '\0');
+    result.resize(decryptPermutationTextInto(ciphertext.data(), ciphertext.size(), key, &result[0], result.size()));
+    return result;
+}
+
+//шифрование текста в буфер вызывающего
+size_t encryptPermutationTextInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_ENCRYPT_TEXT, length);
+    if (length == 0) return 0;
     
-    sort(keyWithIndex.begin(), keyWithIndex.end(), 
-         [](const pair<string, int>& a, const pair<string, int>& b) {
-             return a.first == b.first ? a.second < b.second : a.first < b.first;
-         });
+    return encryptPermutationTextWithOrder(data, length, *textKey(key), out, outCapacity);
+}
+
+//дешифрование текста в буфер вызывающего
+size_t decryptPermutationTextInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_DECRYPT_TEXT, length);
+    if (length == 0) return 0;
     
-    vector<int> columnOrder(keyWithIndex.size());
-    for (size_t i = 0; i < keyWithIndex.size(); ++i) {
-        columnOrder[keyWithIndex[i].second] = i;
-    }
+    return decryptPermutationTextWithOrder(data, length, *textKey(key), out, outCapacity);
+}
 
-    int cols = keyWithIndex.size();
-    size_t effectiveLength = countEffectiveChars(ciphertext);
-    int rows = (effectiveLength + cols - 1) / cols;
+//размер выходного буфера. Бинарное шифрование дополняет данные до целого
+//числа строк таблицы; в текстовом режиме пустые ячейки последней строки
+//заполняются '_', их не больше cols - 1
+size_t permutationOutputSize(size_t inputLength, const string& key, bool decrypt, bool binary) {
+    if (inputLength == 0 || key.empty()) return inputLength;
+    
+    if (binary) {
+        if (decrypt) return inputLength;
+        size_t cols = key.size();
+        return (inputLength + cols - 1) / cols * cols;
+    }
     
-    vector<vector<string>> table(rows, vector<string>(cols, "_"));
+    size_t cols = textKey(key)->columnOrder.size();
+    if (cols == 0) return inputLength;
+    return inputLength + cols - 1;
+}
+
+//настройка параллельной обработки бинарных данных
+void setPermutationParallelism(unsigned threads, size_t minBytes) {
+    configureParallelism(parallelSettings, threads, minBytes);
+}
+
+//счётчики кэшей ключей обоих режимов
+void permutationKeyCacheStats(CipherKeyCacheStats* stats) {
+    if (!stats) return;
+    CipherKeyCacheStats binary = binaryKeyCache.stats();
+    CipherKeyCacheStats text = textKeyCache.stats();
+    stats->hits = binary.hits + text.hits;
+    stats->misses = binary.misses + text.misses;
+    stats->entries = binary.entries + text.entries;
+    stats->capacity = binary.capacity + text.capacity;
+}
+
+//включение счётчиков вызовов
+void setPermutationMetricsEnabled(bool enabled) {
+    callMetrics.setEnabled(enabled);
+}
+
+//счётчики вызовов
+void permutationMetrics(CipherMetrics* metrics) {
+    if (metrics) callMetrics.snapshot(metrics);
+}
+
+//контекст пошаговой обработки. Перестановка переставляет столбцы всей таблицы,
+//форма которой зависит от общей длины данных, поэтому update только накапливает
+//данные, а результат выдаётся в final
+struct PermutationContext {
+    shared_ptr<const PermutationKey> key;
+    bool decrypt;
+    bool binary;
+    bool emptyKey;      //для бинарного режима пустой ключ оставляет данные без изменений
+    string buffer;
+};
+
+PermutationContext* permutationInit(const string& key, bool decrypt, bool binary) {
+    PermutationContext* ctx = new PermutationContext();
+    ctx->decrypt = decrypt;
+    ctx->binary = binary;
+    ctx->emptyKey = key.empty();
+    ctx->key = binary ? binaryKey(key) : textKey(key);
+    return ctx;
+}
+
+string permutationUpdate(PermutationContext* ctx, const string& data) {
+    ctx->buffer += data;
+    return "";
+}
+
+string permutationFinal(PermutationContext* ctx) {
+    unique_ptr<PermutationContext> owner(ctx);
+    ScopedMetric metric(callMetrics, cipherMetricOperation(ctx->decrypt, ctx->binary), ctx->buffer.size());
+    if (ctx->buffer.empty()) return "";
     
-    size_t cipherIndex = 0;
-    for (int colIndex = 0; colIndex < cols; ++colIndex) {
-        int originalCol = -1;
-        for (int i = 0; i < cols; ++i) {
-            if (columnOrder[i] == colIndex) {
-                originalCol = i;
-                break;
-            }
-        }
+    if (ctx->binary) {
+        if (ctx->emptyKey) return ctx->buffer;
         
-        for (int i = 0; i < rows; ++i) {
-            if (cipherIndex < ciphertext.length()) {
-                table[i][originalCol] = getCharAt(ciphertext, cipherIndex);
-            }
-        }
+        size_t cols = ctx->key->columnOrder.size();
+        string result((ctx->buffer.size() + cols - 1) / cols * cols, '\0');
+        size_t written = ctx->decrypt
+            ? decryptPermutationBinaryWithOrder(ctx->buffer.data(), ctx->buffer.size(), *ctx->key, &result[0])
+            : encryptPermutationBinaryWithOrder(ctx->buffer.data(), ctx->buffer.size(), *ctx->key, &result[0]);
+        result.resize(written);
+        return result;
     }
     
-    string plaintext;
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            plaintext += table[i][j];
-        }
+    size_t cols = ctx->key->columnOrder.size();
+    string result(ctx->buffer.size() + (cols > 0 ? cols - 1 : 0), '\0');
+    size_t written = ctx->decrypt
+        ? decryptPermutationTextWithOrder(ctx->buffer.data(), ctx->buffer.size(), *ctx->key, &result[0], result.size())
+        : encryptPermutationTextWithOrder(ctx->buffer.data(), ctx->buffer.size(), *ctx->key, &result[0], result.size());
+    result.resize(written);
+    return result;
+}
+
+//двоичный интерфейс плагина (cipher_plugin.h)
+
+static int pluginEncryptBinary(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                               uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    if (offset != 0) {
+        return setPluginError(CIPHER_ERROR_UNSUPPORTED, "Перестановка обрабатывает данные только целиком");
     }
-    
-    size_t lastChar = plaintext.find_last_not_of('_');
-    if (lastChar != string::npos) {
-        plaintext = plaintext.substr(0, lastChar + 1);
+    return guardPluginCall(written, [&] {
+        return encryptPermutationBinaryInto(reinterpret_cast<const char*>(data), length, pluginKey(key, keyLength),
+                                            reinterpret_cast<char*>(out), outCapacity);
+    });
+}
+
+static int pluginDecryptBinary(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                               uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    if (offset != 0) {
+        return setPluginError(CIPHER_ERROR_UNSUPPORTED, "Перестановка обрабатывает данные только целиком");
     }
-    
-    return restoreUnderscoresToSpaces(plaintext);
-}
\ No newline at end of file
+    return guardPluginCall(written, [&] {
+        return decryptPermutationBinaryInto(reinterpret_cast<const char*>(data), length, pluginKey(key, keyLength),
+                                            reinterpret_cast<char*>(out), outCapacity);
+    });
+}
+
+static int pluginEncryptText(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                             uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    if (offset != 0) {
+        return setPluginError(CIPHER_ERROR_UNSUPPORTED, "Перестановка обрабатывает данные только целиком");
+    }
+    return guardPluginCall(written, [&] {
+        return encryptPermutationTextInto(reinterpret_cast<const char*>(data), length, pluginKey(key, keyLength),
+                                          reinterpret_cast<char*>(out), outCapacity);
+    });
+}
+
+static int pluginDecryptText(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                             uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    if (offset != 0) {
+        return setPluginError(CIPHER_ERROR_UNSUPPORTED, "Перестановка обрабатывает данные только целиком");
+    }
+    return guardPluginCall(written, [&] {
+        return decryptPermutationTextInto(reinterpret_cast<const char*>(data), length, pluginKey(key, keyLength),
+                                          reinterpret_cast<char*>(out), outCapacity);
+    });
+}
+
+static void pluginSetMetricsEnabled(int enabled) {
+    callMetrics.setEnabled(enabled != 0);
+}
+
+static size_t pluginOutputSize(size_t length, const uint8_t* key, size_t keyLength, int decrypt, int binary) {
+    return permutationOutputSize(length, pluginKey(key, keyLength), decrypt != 0, binary != 0);
+}
+
+//перестановка переставляет данные между строками таблицы, поэтому результат
+//пишется только в отдельный буфер и только для всего сообщения сразу
+const CipherPluginDescriptor* permutationPluginDescriptor() {
+    static const CipherPluginDescriptor descriptor = {
+        CIPHER_PLUGIN_ABI_VERSION,
+        sizeof(CipherPluginDescriptor),
+        "permutation",
+        CIPHER_CAP_PARALLEL_SAFE,
+        CIPHER_SIMD_NONE,
+        CIPHER_SIZE_VARIABLE,
+        pluginOutputSize,
+        pluginEncryptBinary,
+        pluginDecryptBinary,
+        pluginEncryptText,
+        pluginDecryptText,
+        setPermutationParallelism,
+        pluginLastError,
+        permutationKeyCacheStats,
+        pluginSetMetricsEnabled,
+        permutationMetrics
+    };
+    return &descriptor;
+}
@@ -2,6 +2,7 @@
 #define CIPHER_PERMUTATION_H
 
 #include <string>
+#include "cipher_plugin.h"
 using namespace std;
 
 #ifdef __cplusplus
@@ -20,6 +21,59 @@ string encryptPermutationBinary(const string& data, const string& key);
 __attribute__((visibility("default")))
 string decryptPermutationBinary(const string& data, const string& key);
 
+//варианты с буфером вызывающего: результат пишется в out ёмкостью outCapacity,
+//возвращается число записанных байт (length_error, если буфер мал)
+__attribute__((visibility("default")))
+size_t encryptPermutationTextInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity);
+
+__attribute__((visibility("default")))
+size_t decryptPermutationTextInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity);
+
+__attribute__((visibility("default")))
+size_t encryptPermutationBinaryInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity);
+
+__attribute__((visibility("default")))
+size_t decryptPermutationBinaryInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity);
+
+//размер выходного буфера, достаточный для результата в данном режиме
+__attribute__((visibility("default")))
+size_t permutationOutputSize(size_t inputLength, const string& key, bool decrypt, bool binary);
+
+//параллельная обработка бинарных данных: threads потоков (0 - по числу ядер),
+//данные меньше minBytes на поток обрабатываются в одном потоке
+__attribute__((visibility("default")))
+void setPermutationParallelism(unsigned threads, size_t minBytes);
+
+//счётчики кэшей скомпилированных ключей (бинарного и текстового режимов вместе)
+__attribute__((visibility("default")))
+void permutationKeyCacheStats(CipherKeyCacheStats* stats);
+
+//счётчики вызовов: число, объём данных, время и гистограмма задержек по
+//операциям. Сбор по умолчанию выключен
+__attribute__((visibility("default")))
+void setPermutationMetricsEnabled(bool enabled);
+
+__attribute__((visibility("default")))
+void permutationMetrics(CipherMetrics* metrics);
+
+//пошаговая обработка: ключ разбирается один раз в init; так как перестановка
+//требует все данные, update накапливает их, а final выдаёт результат
+//и освобождает контекст
+struct PermutationContext;
+
+__attribute__((visibility("default")))
+PermutationContext* permutationInit(const string& key, bool decrypt, bool binary);
+
+__attribute__((visibility("default")))
+string permutationUpdate(PermutationContext* ctx, const string& data);
+
+__attribute__((visibility("default")))
+string permutationFinal(PermutationContext* ctx);
+
+//описание библиотеки для двоичного интерфейса плагинов (cipher_plugin.h)
+__attribute__((visibility("default")))
+const CipherPluginDescriptor* permutationPluginDescriptor();
+
 #ifdef __cplusplus
 }
 #endif
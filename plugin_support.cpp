@@ -0,0 +1,25 @@
+#include "plugin_support.h"
+#include "kernels.h"
+
+//ошибка хранится отдельно для каждого потока, как errno
+static thread_local string lastErrorMessage;
+
+int setPluginError(int status, const char* message) {
+    lastErrorMessage = message;
+    return status;
+}
+
+const char* pluginLastError() {
+    return lastErrorMessage.c_str();
+}
+
+uint32_t pluginSimdLevel() {
+    switch (detectSimdLevel()) {
+        case SimdLevel::AVX2:
+            return CIPHER_SIMD_AVX2;
+        case SimdLevel::SSE2:
+            return CIPHER_SIMD_SSE2;
+        default:
+            return CIPHER_SIMD_NONE;
+    }
+}
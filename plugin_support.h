@@ -0,0 +1,49 @@
+#ifndef PLUGIN_SUPPORT_H
+#define PLUGIN_SUPPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "cipher_plugin.h"
+
+using namespace std;
+
+//запоминает текст ошибки для lastError и возвращает status
+int setPluginError(int status, const char* message);
+
+//текст последней ошибки в вызывающем потоке
+const char* pluginLastError();
+
+//уровень векторизации шифра в терминах CipherSimdLevel
+uint32_t pluginSimdLevel();
+
+//ключ из буфера интерфейса
+inline string pluginKey(const uint8_t* key, size_t keyLength) {
+    return string(reinterpret_cast<const char*>(key), keyLength);
+}
+
+//вызов функции шифра из интерфейса плагина: call() возвращает длину результата,
+//исключения переводятся в коды CipherStatus и не выходят за границу библиотеки
+template <typename Call>
+int guardPluginCall(size_t* written, Call call) {
+    try {
+        size_t length = call();
+        if (written) *written = length;
+        return CIPHER_OK;
+    } catch (const length_error& e) {
+        return setPluginError(CIPHER_ERROR_BUFFER_TOO_SMALL, e.what());
+    } catch (const invalid_argument& e) {
+        return setPluginError(CIPHER_ERROR_INVALID_ARGUMENT, e.what());
+    } catch (const bad_alloc&) {
+        return setPluginError(CIPHER_ERROR_NO_MEMORY, "Недостаточно памяти");
+    } catch (const exception& e) {
+        return setPluginError(CIPHER_ERROR_INTERNAL, e.what());
+    } catch (...) {
+        return setPluginError(CIPHER_ERROR_INTERNAL, "Неизвестная ошибка шифра");
+    }
+}
+
+#endif
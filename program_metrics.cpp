@@ -0,0 +1,102 @@
+#include "program_metrics.h"
+#include <algorithm>
+#include <new>
+#include <cstdlib>
+
+using namespace std;
+
+const char* const PROGRAM_METRIC_NAMES[PROGRAM_METRIC_COUNT] = {
+    "load_library",
+    "read",
+    "write",
+    "map",
+    "cipher",
+    "file"
+};
+
+MetricsRegistry& programMetrics() {
+    static MetricsRegistry metrics(PROGRAM_METRIC_COUNT);
+    return metrics;
+}
+
+//счётчик выделений памяти текущего потока для отчёта --stats. Операторы
+//new и delete заменены во всей программе (включая выделения внутри
+//библиотек шифров) во всех формах: обычной, для массивов, nothrow и с
+//выравниванием. Флаг меняется только до запуска рабочих потоков
+static bool countAllocations = false;
+static thread_local uint64_t threadAllocations = 0;
+
+static uint64_t threadAllocationCount() {
+    return threadAllocations;
+}
+
+void enableAllocationCounting() {
+    countAllocations = true;
+    programMetrics().setAllocationCounter(threadAllocationCount);
+}
+
+static void* allocate(size_t size) noexcept {
+    if (countAllocations) threadAllocations++;
+    return malloc(size ? size : 1);
+}
+
+static void* allocateAligned(size_t size, align_val_t alignment) noexcept {
+    if (countAllocations) threadAllocations++;
+    void* memory;
+    size_t bytes = max(static_cast<size_t>(alignment), sizeof(void*));
+    return posix_memalign(&memory, bytes, size ? size : 1) == 0 ? memory : nullptr;
+}
+
+void* operator new(size_t size) {
+    void* memory = allocate(size);
+    if (!memory) throw bad_alloc();
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    void* memory = allocate(size);
+    if (!memory) throw bad_alloc();
+    return memory;
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    void* memory = allocateAligned(size, alignment);
+    if (!memory) throw bad_alloc();
+    return memory;
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+    void* memory = allocateAligned(size, alignment);
+    if (!memory) throw bad_alloc();
+    return memory;
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return allocateAligned(size, alignment);
+}
+
+//память всех форм выделена malloc или posix_memalign и освобождается free
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+void operator delete(void* memory, const nothrow_t&) noexcept { free(memory); }
+void operator delete[](void* memory, const nothrow_t&) noexcept { free(memory); }
+void operator delete(void* memory, align_val_t) noexcept { free(memory); }
+void operator delete[](void* memory, align_val_t) noexcept { free(memory); }
+void operator delete(void* memory, size_t, align_val_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t, align_val_t) noexcept { free(memory); }
+void operator delete(void* memory, align_val_t, const nothrow_t&) noexcept { free(memory); }
+void operator delete[](void* memory, align_val_t, const nothrow_t&) noexcept { free(memory); }
@@ -0,0 +1,30 @@
+#ifndef PROGRAM_METRICS_H
+#define PROGRAM_METRICS_H
+
+#include "metrics.h"
+
+using namespace std;
+
+//этапы работы программы с файлами, по которым ведутся счётчики
+enum ProgramMetric {
+    PROGRAM_METRIC_LOAD_LIBRARY = 0,    //загрузка библиотеки шифра
+    PROGRAM_METRIC_READ,                //чтение из дескриптора
+    PROGRAM_METRIC_WRITE,               //запись в дескриптор
+    PROGRAM_METRIC_MAP,                 //отображение файлов в память и его завершение
+    PROGRAM_METRIC_CIPHER,              //вызовы шифра из файловых путей
+    PROGRAM_METRIC_FILE,                //обработка файла целиком
+    PROGRAM_METRIC_COUNT
+};
+
+//названия этапов для отчётов
+extern const char* const PROGRAM_METRIC_NAMES[PROGRAM_METRIC_COUNT];
+
+//счётчики этапов программы (сбор включается параметром --stats)
+MetricsRegistry& programMetrics();
+
+//включение учёта выделений памяти в счётчиках программы. Вызывается до
+//запуска рабочих потоков; без вызова замещённые операторы new только
+//проверяют флаг
+void enableAllocationCounting();
+
+#endif
@@ -0,0 +1,123 @@
+#include "thread_pool.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <exception>
+#include <algorithm>
+
+using namespace std;
+
+//границы диапазонов выравниваются по строке кэша
+static const size_t RANGE_ALIGNMENT = 64;
+
+//пул рабочих потоков, общий для всех вызовов. Потоки создаются по мере
+//необходимости и живут до выгрузки библиотеки
+class ThreadPool {
+public:
+    static ThreadPool& instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+    
+    //выполняет task(0) .. task(count - 1): задача 0 - в вызывающем потоке,
+    //остальные - в пуле. Возвращает управление, когда выполнены все задачи
+    void run(size_t count, const function<void(size_t)>& task) {
+        mutex doneMutex;
+        condition_variable doneCondition;
+        size_t remaining = count - 1;
+        exception_ptr error;
+        
+        {
+            lock_guard<mutex> lock(queueMutex);
+            while (workers.size() < count - 1) {
+                workers.emplace_back([this] { workerLoop(); });
+            }
+            for (size_t i = 1; i < count; i++) {
+                queue.push_back([&, i] {
+                    try {
+                        task(i);
+                    } catch (...) {
+                        lock_guard<mutex> doneLock(doneMutex);
+                        if (!error) error = current_exception();
+                    }
+                    lock_guard<mutex> doneLock(doneMutex);
+                    if (--remaining == 0) doneCondition.notify_one();
+                });
+            }
+        }
+        queueCondition.notify_all();
+        
+        try {
+            task(0);
+        } catch (...) {
+            lock_guard<mutex> doneLock(doneMutex);
+            if (!error) error = current_exception();
+        }
+        
+        unique_lock<mutex> doneLock(doneMutex);
+        doneCondition.wait(doneLock, [&] { return remaining == 0; });
+        if (error) rethrow_exception(error);
+    }
+    
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+    }
+    
+private:
+    ThreadPool() : stopping(false) {}
+    
+    void workerLoop() {
+        while (true) {
+            function<void()> job;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueCondition.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping && queue.empty()) return;
+                job = move(queue.front());
+                queue.pop_front();
+            }
+            job();
+        }
+    }
+    
+    vector<thread> workers;
+    deque<function<void()>> queue;
+    mutex queueMutex;
+    condition_variable queueCondition;
+    bool stopping;
+};
+
+void configureParallelism(ParallelSettings& settings, unsigned threads, size_t minBytes) {
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    settings.threads = threads;
+    settings.minBytes = max<size_t>(minBytes, RANGE_ALIGNMENT);
+}
+
+void parallelRanges(size_t length, const ParallelSettings& settings,
+                    const function<void(size_t, size_t)>& body) {
+    size_t parts = min<size_t>(settings.threads, length / settings.minBytes);
+    if (parts < 2) {
+        body(0, length);
+        return;
+    }
+    
+    size_t rangeSize = (length / parts + RANGE_ALIGNMENT - 1) / RANGE_ALIGNMENT * RANGE_ALIGNMENT;
+    parts = (length + rangeSize - 1) / rangeSize;
+    
+    ThreadPool::instance().run(parts, [&](size_t part) {
+        size_t begin = part * rangeSize;
+        size_t end = min(length, begin + rangeSize);
+        body(begin, end);
+    });
+}
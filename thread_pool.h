@@ -0,0 +1,29 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <cstddef>
+#include <functional>
+
+using namespace std;
+
+//минимальный объём данных на один поток по умолчанию
+const size_t DEFAULT_PARALLEL_MIN_BYTES = 256 * 1024;
+
+//настройки параллельной обработки шифра
+struct ParallelSettings {
+    unsigned threads;       //число потоков (1 - без распараллеливания)
+    size_t minBytes;        //минимальный объём данных на один поток
+    
+    ParallelSettings() : threads(1), minBytes(DEFAULT_PARALLEL_MIN_BYTES) {}
+};
+
+//задаёт настройки; threads == 0 означает число ядер процессора
+void configureParallelism(ParallelSettings& settings, unsigned threads, size_t minBytes);
+
+//делит [0, length) на непересекающиеся диапазоны и вызывает body(begin, end)
+//для каждого на потоках общего пула. Если данных меньше чем на два потока,
+//body вызывается один раз в текущем потоке
+void parallelRanges(size_t length, const ParallelSettings& settings,
+                    const function<void(size_t, size_t)>& body);
+
+#endif
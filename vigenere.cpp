@@ -1,5 +1,11 @@
 #include "vigenere.h"
 #include "utils.h"
+#include "kernels.h"
+#include "cyrillic.h"
+#include "thread_pool.h"
+#include "plugin_support.h"
+#include "key_cache.h"
+#include "metrics.h"
 #include <string>
 #include <algorithm>
 #include <stdexcept>
@@ -11,42 +17,7 @@ using namespace std;
 int getCyrillicPositionUTF8(const string& str, size_t pos) {
     if (!isCyrillicUTF8(str, pos)) return -1;
     
-    string cyrChar = str.substr(pos, 2);
-    //проверяем оба регистра одновременно
-    vector<string> alphabetLower = getCyrillicAlphabet(false);
-    vector<string> alphabetUpper = getCyrillicAlphabet(true);
-    
-    for (size_t i = 0; i < alphabetLower.size(); i++) {
-        if (alphabetLower[i] == cyrChar || alphabetUpper[i] == cyrChar) {
-            return i;
-        }
-    }
-    
-    return -1;
-}
-
-//получает кириллический символ по позиции с сохранением регистра оригинала
-string getCyrillicFromPositionUTF8(int pos, const string& originalChar) {
-    if (pos < 0 || pos >= 33) return "?";
-    
-    vector<string> alphabetLower = getCyrillicAlphabet(false);
-    vector<string> alphabetUpper = getCyrillicAlphabet(true);
-    
-    //определяем регистр оригинального символа
-    bool isLower = false;
-    for (size_t i = 0; i < alphabetLower.size(); i++) {
-        if (alphabetLower[i] == originalChar) {
-            isLower = true;
-            break;
-        }
-    }
-    
-    //для заглавных используем upper, для строчных - lower
-    if (isLower) {
-        return alphabetLower[pos];
-    } else {
-        return alphabetUpper[pos];
-    }
+    return cyrillicPosition(static_cast<unsigned char>(str[pos]), static_cast<unsigned char>(str[pos + 1]));
 }
 
 //функция для получения числового значения символа ключа (0-255)
@@ -117,54 +88,197 @@ string expandKey(const string& text, const string& key) {
     return expandedKey;
 }
 
-//функция шифрования
-string encryptVigenere(const string& plaintext, const string& key, bool useCyrillic) {
-    if (plaintext.empty()) return plaintext;
+//скомпилированный ключ: по каждому символу ключа (ASCII или кириллическая пара)
+//готовые сдвиги для всех видов байтов текста. Строится один раз на вызов
+//(или на контекст), при обработке текста строка ключа больше не разбирается
+struct VigenereSchedule {
+    size_t period = 0;                      //число символов ключа
+    vector<unsigned char> cyrillicRotation; //сдвиг кириллической буквы (0..32)
+    vector<unsigned char> letterPattern;    //сдвиг латинской буквы (знаковый байт), шаблон kernels.h
+    vector<unsigned char> otherPattern;     //прибавка к остальным байтам по модулю 256, шаблон kernels.h
+};
+
+//разбор ключа тем же getKeyValue, что и раньше в посимвольной обработке.
+//При дешифровании сдвиги записываются с обратным знаком
+static void compileVigenereKey(const string& key, bool decrypt, VigenereSchedule& schedule) {
+    vector<unsigned char> letterShifts;
+    vector<unsigned char> otherShifts;
+    letterShifts.reserve(key.length());
+    otherShifts.reserve(key.length());
+    schedule.cyrillicRotation.reserve(key.length());
+    size_t keyPos = 0;
     
-    string preparedKey = prepareKey(key);
-    if (preparedKey.empty()) {
-        throw invalid_argument("Ключ не должен быть пустым");
+    while (keyPos < key.length()) {
+        int shift = getKeyValue(key, keyPos);
+        int rotation = (shift + 1) % CYRILLIC_ALPHABET_SIZE;
+        if (decrypt) rotation = (CYRILLIC_ALPHABET_SIZE - rotation) % CYRILLIC_ALPHABET_SIZE;
+        
+        schedule.cyrillicRotation.push_back(static_cast<unsigned char>(rotation));
+        letterShifts.push_back(static_cast<unsigned char>(decrypt ? 26 - shift : shift % 26));
+        otherShifts.push_back(static_cast<unsigned char>(decrypt ? 1 - shift : shift + 1));
     }
     
-    string ciphertext;
-    size_t keyPos = 0;
+    schedule.period = letterShifts.size();
+    buildKeyPattern(letterShifts.data(), letterShifts.size(), schedule.letterPattern);
+    buildKeyPattern(otherShifts.data(), otherShifts.size(), schedule.otherPattern);
+}
+
+//вид байта текста
+enum TextByteClass : unsigned char {
+    TEXT_BYTE_OTHER = 0,
+    TEXT_BYTE_UPPER = 1,    //A-Z
+    TEXT_BYTE_LOWER = 2,    //a-z
+    TEXT_BYTE_CYRILLIC = 3  //первый байт кириллического символа (0xD0, 0xD1)
+};
+
+struct TextByteClassTable {
+    unsigned char byteClass[256];
+};
+
+constexpr TextByteClassTable buildTextByteClassTable() {
+    TextByteClassTable table{};
+    for (int c = 'A'; c <= 'Z'; c++) table.byteClass[c] = TEXT_BYTE_UPPER;
+    for (int c = 'a'; c <= 'z'; c++) table.byteClass[c] = TEXT_BYTE_LOWER;
+    table.byteClass[0xD0] = TEXT_BYTE_CYRILLIC;
+    table.byteClass[0xD1] = TEXT_BYTE_CYRILLIC;
+    return table;
+}
+
+static constexpr TextByteClassTable TEXT_BYTE_CLASSES = buildTextByteClassTable();
+
+//начало алфавита для латинских букв, 0 - байт не является латинской буквой
+static constexpr unsigned char LATIN_BASE[4] = {0, 'A', 'a', 0};
+
+//участки без кириллицы короче этого обрабатываются скалярно: на них
+//не окупается вызов векторного ядра
+static const size_t TEXT_SIMD_MIN_RUN = 32;
+
+//шифрование/дешифрование текста длины length в буфер out той же длины
+//по скомпилированному ключу, keyIndex (номер символа ключа) сохраняется между
+//вызовами. Если flush == false и текст заканчивается первым байтом
+//кириллического символа, он не обрабатывается (ждём второй байт).
+//Длинные участки между кириллическими символами сдвигаются векторно.
+//text и out могут совпадать: каждый байт читается до записи на его место.
+//Возвращает число обработанных (и записанных) байт
+static size_t transformVigenereText(const char* text, size_t length, const VigenereSchedule& schedule,
+                                    size_t& keyIndex, bool useCyrillic, bool flush, char* out) {
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(text);
+    const unsigned char* letterShift = schedule.letterPattern.data();
+    const unsigned char* otherShift = schedule.otherPattern.data();
+    size_t period = schedule.period;
+    size_t i = 0;
     
-    for (size_t i = 0; i < plaintext.length(); ) {
-        int shift = getKeyValue(preparedKey, keyPos);
+    while (i < length) {
+        unsigned char currentChar = input[i];
+        bool isPair = useCyrillic && TEXT_BYTE_CLASSES.byteClass[currentChar] == TEXT_BYTE_CYRILLIC;
+        if (isPair && i + 1 == length) {
+            if (!flush) break;
+            isPair = false;
+        }
         
-        //шифрование кириллицы
-        if (useCyrillic && isCyrillicUTF8(plaintext, i)) {
-            string cyrChar = plaintext.substr(i, 2);
-            int textPos = getCyrillicPositionUTF8(plaintext, i);
+        //обработка кириллицы
+        if (isPair) {
+            const CyrillicLetter* row = cyrillicShiftRow(currentChar, input[i + 1]);
             
-            if (textPos != -1) {
-                int newPos = (textPos + shift + 1) % 33;
-                string encryptedChar = getCyrillicFromPositionUTF8(newPos, cyrChar);
-                ciphertext += encryptedChar;
+            if (row) {
+                unsigned char rotation = schedule.cyrillicRotation[keyIndex];
+                out[i] = static_cast<char>(row[rotation].lead);
+                out[i + 1] = static_cast<char>(row[rotation].trail);
             } else {
-                ciphertext += cyrChar;
+                out[i] = text[i];
+                out[i + 1] = text[i + 1];
             }
+            if (++keyIndex == period) keyIndex = 0;
             i += 2;
+            continue;
+        }
+        
+        //участок символов ASCII до следующего кириллического символа
+        size_t runEnd = useCyrillic ? i + 1 + findCyrillicLead(input + i + 1, length - i - 1) : length;
+        size_t run = runEnd - i;
+        
+        if (run >= TEXT_SIMD_MIN_RUN) {
+            applyLatinShift(input + i, reinterpret_cast<unsigned char*>(out + i), run,
+                            letterShift, otherShift, period, keyIndex);
+            keyIndex = (keyIndex + run) % period;
+            i = runEnd;
+            continue;
         }
-        //шифрование символов ASCII
-        else {
-            unsigned char currentChar = plaintext[i];
-            unsigned char encryptedChar;
-
-            if (isalpha(currentChar)) {
-                //для латинских букв - шифрование с сохранением регистра
-                char base = isupper(currentChar) ? 'A' : 'a';
-                encryptedChar = (currentChar - base + shift) % 26 + base;
+        
+        for (; i < runEnd; i++) {
+            unsigned char c = input[i];
+            unsigned char base = LATIN_BASE[TEXT_BYTE_CLASSES.byteClass[c]];
+            
+            if (base) {
+                //для латинских букв - сдвиг с сохранением регистра
+                int d = c - base + static_cast<signed char>(letterShift[keyIndex]);
+                if (d > 25) d -= 26;
+                out[i] = static_cast<char>(base + d);
             } else {
-                //для остальных символов - простое сложение по модулю 256
-                encryptedChar = (currentChar + shift + 1) % 256;
+                //для остальных символов - сложение/вычитание по модулю 256
+                out[i] = static_cast<char>(c + otherShift[keyIndex]);
             }
-
-            ciphertext += static_cast<char>(encryptedChar);
-            i++;
+            if (++keyIndex == period) keyIndex = 0;
         }
     }
     
+    return i;
+}
+
+//ключ, скомпилированный для всех режимов: расписания текстового режима
+//для обоих направлений и шаблон байтов ключа для бинарного режима
+struct VigenereKey {
+    VigenereSchedule text[2];           //[0] - шифрование, [1] - дешифрование
+    size_t length;                      //длина ключа в байтах
+    vector<unsigned char> bytePattern;
+};
+
+static KeyCache<VigenereKey> keyCache;
+
+//ключ из кэша; при первом использовании строки он компилируется.
+//Пустой ключ обрабатывается вызывающим до обращения к кэшу
+static shared_ptr<const VigenereKey> compiledKey(const string& key) {
+    return keyCache.get(key, [](const string& text) {
+        VigenereKey compiled;
+        compileVigenereKey(text, false, compiled.text[0]);
+        compileVigenereKey(text, true, compiled.text[1]);
+        compiled.length = text.size();
+        buildKeyPattern(reinterpret_cast<const unsigned char*>(text.data()), text.size(), compiled.bytePattern);
+        return compiled;
+    });
+}
+
+//настройки параллельной обработки бинарных данных
+static ParallelSettings parallelSettings;
+
+//счётчики вызовов по операциям (CipherMetricOperation)
+static MetricsRegistry callMetrics(CIPHER_METRIC_OPERATIONS);
+
+//бинарная обработка, offset - позиция первого байта data в потоке. Байт i
+//зависит только от data[i] и key[(offset + i) % keyLen], поэтому большие
+//данные делятся на диапазоны со своей начальной фазой ключа
+static void transformVigenereBinary(const char* data, size_t length, const VigenereKey& key,
+                                    size_t offset, bool decrypt, char* out) {
+    parallelRanges(length, parallelSettings, [&](size_t begin, size_t end) {
+        applyKeyPattern(reinterpret_cast<const unsigned char*>(data + begin), reinterpret_cast<unsigned char*>(out + begin),
+                        end - begin, key.bytePattern.data(), key.length, (offset + begin) % key.length, decrypt);
+    });
+}
+
+//проверка размера буфера вызывающего
+static void checkOutputCapacity(size_t required, size_t outCapacity) {
+    if (outCapacity < required) {
+        throw length_error("Недостаточный размер выходного буфера");
+    }
+}
+
+//функция шифрования
+string encryptVigenere(const string& plaintext, const string& key, bool useCyrillic) {
+    if (plaintext.empty()) return plaintext;
+    
+    string ciphertext(plaintext.size(), '\0');
+    encryptVigenereInto(plaintext.data(), plaintext.size(), key, &ciphertext[0], ciphertext.size(), useCyrillic);
+    
     return ciphertext;
 }
 
@@ -172,81 +286,297 @@ string encryptVigenere(const string& plaintext, const string& key, bool useCyril
 string decryptVigenere(const string& ciphertext, const string& key, bool useCyrillic) {
     if (ciphertext.empty()) return ciphertext;
     
+    string plaintext(ciphertext.size(), '\0');
+    decryptVigenereInto(ciphertext.data(), ciphertext.size(), key, &plaintext[0], plaintext.size(), useCyrillic);
+    
+    return plaintext;
+}
+
+//бинарное шифрование Виженера
+string encryptVigenereBinary(const string& data, const string& key) {
+    return encryptVigenereBinaryAt(data, key, 0);
+}
+
+//бинарное дешифрование Виженера
+string decryptVigenereBinary(const string& data, const string& key) {
+    return decryptVigenereBinaryAt(data, key, 0);
+}
+
+//бинарное шифрование Виженера, offset - позиция первого байта data в потоке
+string encryptVigenereBinaryAt(const string& data, const string& key, size_t offset) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_ENCRYPT_BINARY, data.size());
+    if (data.empty() || key.empty()) return data;
+    
+    string result(data.size(), '\0');
+    transformVigenereBinary(data.data(), data.size(), *compiledKey(key), offset, false, &result[0]);
+    
+    return result;
+}
+
+//бинарное дешифрование Виженера, offset - позиция первого байта data в потоке
+string decryptVigenereBinaryAt(const string& data, const string& key, size_t offset) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_DECRYPT_BINARY, data.size());
+    if (data.empty() || key.empty()) return data;
+    
+    string result(data.size(), '\0');
+    transformVigenereBinary(data.data(), data.size(), *compiledKey(key), offset, true, &result[0]);
+    
+    return result;
+}
+
+//шифрование текста в буфер вызывающего
+size_t encryptVigenereInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity, bool useCyrillic) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_ENCRYPT_TEXT, length);
+    if (length == 0) return 0;
+    
     string preparedKey = prepareKey(key);
     if (preparedKey.empty()) {
         throw invalid_argument("Ключ не должен быть пустым");
     }
+    checkOutputCapacity(length, outCapacity);
     
-    string plaintext;
-    size_t keyPos = 0;
+    shared_ptr<const VigenereKey> compiled = compiledKey(preparedKey);
+    size_t keyIndex = 0;
+    return transformVigenereText(data, length, compiled->text[0], keyIndex, useCyrillic, true, out);
+}
+
+//дешифрование текста в буфер вызывающего
+size_t decryptVigenereInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity, bool useCyrillic) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_DECRYPT_TEXT, length);
+    if (length == 0) return 0;
     
-    for (size_t i = 0; i < ciphertext.length(); ) {
-        int shift = getKeyValue(preparedKey, keyPos);
-        
-        //дешифрование кириллицы
-        if (useCyrillic && isCyrillicUTF8(ciphertext, i)) {
-            string cyrChar = ciphertext.substr(i, 2);
-            int textPos = getCyrillicPositionUTF8(ciphertext, i);
-            
-            if (textPos != -1) {
-                int newPos = (textPos - shift - 1 + 33) % 33;
-                string decryptedChar = getCyrillicFromPositionUTF8(newPos, cyrChar);
-                plaintext += decryptedChar;
-            } else {
-                plaintext += cyrChar;
-            }
-            i += 2;
-        }
-        //дешифрование остальных символов ASCII
-        else {
-            unsigned char currentChar = ciphertext[i];
-            unsigned char decryptedChar;
-            
-            if (isalpha(currentChar)) {
-                //для латинских букв - дешифрование с сохранением регистра
-                char base = isupper(currentChar) ? 'A' : 'a';
-                decryptedChar = (currentChar - base - shift + 26) % 26 + base;
-            } else {
-                //для остальных символов - простое вычитание по модулю 256
-                decryptedChar = (currentChar - shift + 256 + 1) % 256;
-            }
-            
-            plaintext += static_cast<char>(decryptedChar);
-            i++;
-        }
+    string preparedKey = prepareKey(key);
+    if (preparedKey.empty()) {
+        throw invalid_argument("Ключ не должен быть пустым");
     }
+    checkOutputCapacity(length, outCapacity);
     
-    return plaintext;
+    shared_ptr<const VigenereKey> compiled = compiledKey(preparedKey);
+    size_t keyIndex = 0;
+    return transformVigenereText(data, length, compiled->text[1], keyIndex, useCyrillic, true, out);
 }
 
-//бинарное шифрование Виженера
-string encryptVigenereBinary(const string& data, const string& key) {
-    if (data.empty() || key.empty()) return data;
-    
-    string result;
-    size_t keyLen = key.size();
+//бинарное шифрование в буфер вызывающего
+size_t encryptVigenereBinaryInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_ENCRYPT_BINARY, length);
+    checkOutputCapacity(length, outCapacity);
+    if (key.empty()) {
+        if (data != out) copy(data, data + length, out);
+        return length;
+    }
     
-    for (size_t i = 0; i < data.length(); ++i) {
-        unsigned char b = static_cast<unsigned char>(data[i]);
-        unsigned char k = static_cast<unsigned char>(key[i % keyLen]);
-        result += static_cast<char>((b + k) % 256);
+    transformVigenereBinary(data, length, *compiledKey(key), 0, false, out);
+    return length;
+}
+
+//бинарное дешифрование в буфер вызывающего
+size_t decryptVigenereBinaryInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_DECRYPT_BINARY, length);
+    checkOutputCapacity(length, outCapacity);
+    if (key.empty()) {
+        if (data != out) copy(data, data + length, out);
+        return length;
     }
     
-    return result;
+    transformVigenereBinary(data, length, *compiledKey(key), 0, true, out);
+    return length;
 }
 
-//бинарное дешифрование Виженера
-string decryptVigenereBinary(const string& data, const string& key) {
-    if (data.empty() || key.empty()) return data;
+//шифрование текста на месте
+void encryptVigenereInPlace(char* data, size_t length, const string& key, bool useCyrillic) {
+    encryptVigenereInto(data, length, key, data, length, useCyrillic);
+}
+
+//дешифрование текста на месте
+void decryptVigenereInPlace(char* data, size_t length, const string& key, bool useCyrillic) {
+    decryptVigenereInto(data, length, key, data, length, useCyrillic);
+}
+
+//бинарное шифрование на месте, offset - позиция первого байта data в потоке
+void encryptVigenereBinaryInPlace(char* data, size_t length, const string& key, size_t offset) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_ENCRYPT_BINARY, length);
+    if (length == 0 || key.empty()) return;
+    transformVigenereBinary(data, length, *compiledKey(key), offset, false, data);
+}
+
+//бинарное дешифрование на месте, offset - позиция первого байта data в потоке
+void decryptVigenereBinaryInPlace(char* data, size_t length, const string& key, size_t offset) {
+    ScopedMetric metric(callMetrics, CIPHER_METRIC_DECRYPT_BINARY, length);
+    if (length == 0 || key.empty()) return;
+    transformVigenereBinary(data, length, *compiledKey(key), offset, true, data);
+}
+
+//размер выходного буфера: шифр Виженера сохраняет длину во всех режимах
+size_t vigenereOutputSize(size_t inputLength, const string& key, bool decrypt, bool binary) {
+    (void)key;
+    (void)decrypt;
+    (void)binary;
+    return inputLength;
+}
+
+//настройка параллельной обработки
+void setVigenereParallelism(unsigned threads, size_t minBytes) {
+    configureParallelism(parallelSettings, threads, minBytes);
+}
+
+//счётчики кэша ключей
+void vigenereKeyCacheStats(CipherKeyCacheStats* stats) {
+    if (stats) *stats = keyCache.stats();
+}
+
+//включение счётчиков вызовов
+void setVigenereMetricsEnabled(bool enabled) {
+    callMetrics.setEnabled(enabled);
+}
+
+//счётчики вызовов
+void vigenereMetrics(CipherMetrics* metrics) {
+    if (metrics) callMetrics.snapshot(metrics);
+}
+
+//контекст пошаговой обработки
+struct VigenereContext {
+    shared_ptr<const VigenereKey> key;
+    bool decrypt;
+    bool binary;
+    bool useCyrillic;
+    size_t keyIndex;    //номер символа ключа (текстовый режим)
+    size_t offset;      //позиция в потоке (бинарный режим)
+    string pending;     //первый байт кириллического символа с конца предыдущего блока
+};
+
+VigenereContext* vigenereInit(const string& key, bool decrypt, bool binary, bool useCyrillic) {
+    string preparedKey = prepareKey(key);
+    if (preparedKey.empty()) {
+        throw invalid_argument("Ключ не должен быть пустым");
+    }
     
-    string result;
-    size_t keyLen = key.size();
+    VigenereContext* ctx = new VigenereContext();
+    ctx->key = compiledKey(preparedKey);
+    ctx->decrypt = decrypt;
+    ctx->binary = binary;
+    ctx->useCyrillic = useCyrillic;
+    ctx->keyIndex = 0;
+    ctx->offset = 0;
+    return ctx;
+}
+
+string vigenereUpdate(VigenereContext* ctx, const string& data) {
+    ScopedMetric metric(callMetrics, cipherMetricOperation(ctx->decrypt, ctx->binary), data.size());
+    if (ctx->binary) {
+        string result(data.size(), '\0');
+        transformVigenereBinary(data.data(), data.size(), *ctx->key, ctx->offset, ctx->decrypt, &result[0]);
+        ctx->offset += data.size();
+        return result;
+    }
     
-    for (size_t i = 0; i < data.length(); ++i) {
-        unsigned char b = static_cast<unsigned char>(data[i]);
-        unsigned char k = static_cast<unsigned char>(key[i % keyLen]);
-        result += static_cast<char>((b - k + 256) % 256);
+    //дописываем байт, оставшийся с прошлого вызова
+    const string* input = &data;
+    string joined;
+    if (!ctx->pending.empty()) {
+        joined = ctx->pending + data;
+        input = &joined;
     }
     
+    string result(input->size(), '\0');
+    size_t stop = transformVigenereText(input->data(), input->size(), ctx->key->text[ctx->decrypt], ctx->keyIndex,
+                                        ctx->useCyrillic, false, &result[0]);
+    result.resize(stop);
+    ctx->pending = input->substr(stop);
     return result;
-}
\ No newline at end of file
+}
+
+string vigenereFinal(VigenereContext* ctx) {
+    string result(ctx->pending.size(), '\0');
+    transformVigenereText(ctx->pending.data(), ctx->pending.size(), ctx->key->text[ctx->decrypt], ctx->keyIndex,
+                          ctx->useCyrillic, true, &result[0]);
+    delete ctx;
+    return result;
+}
+
+//двоичный интерфейс плагина (cipher_plugin.h)
+
+static size_t vigenereBinaryAt(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                               uint64_t offset, uint8_t* out, size_t outCapacity, bool decrypt) {
+    ScopedMetric metric(callMetrics, cipherMetricOperation(decrypt, true), length);
+    checkOutputCapacity(length, outCapacity);
+    const char* input = reinterpret_cast<const char*>(data);
+    char* output = reinterpret_cast<char*>(out);
+    if (keyLength == 0) {
+        if (input != output) copy(input, input + length, output);
+        return length;
+    }
+    
+    transformVigenereBinary(input, length, *compiledKey(pluginKey(key, keyLength)), offset, decrypt, output);
+    return length;
+}
+
+static int pluginEncryptBinary(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                               uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    return guardPluginCall(written, [&] {
+        return vigenereBinaryAt(data, length, key, keyLength, offset, out, outCapacity, false);
+    });
+}
+
+static int pluginDecryptBinary(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                               uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    return guardPluginCall(written, [&] {
+        return vigenereBinaryAt(data, length, key, keyLength, offset, out, outCapacity, true);
+    });
+}
+
+static int pluginEncryptText(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                             uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    if (offset != 0) {
+        return setPluginError(CIPHER_ERROR_UNSUPPORTED, "Текст обрабатывается только целиком");
+    }
+    return guardPluginCall(written, [&] {
+        return encryptVigenereInto(reinterpret_cast<const char*>(data), length, pluginKey(key, keyLength),
+                                   reinterpret_cast<char*>(out), outCapacity, true);
+    });
+}
+
+static int pluginDecryptText(const uint8_t* data, size_t length, const uint8_t* key, size_t keyLength,
+                             uint64_t offset, uint8_t* out, size_t outCapacity, size_t* written) {
+    if (offset != 0) {
+        return setPluginError(CIPHER_ERROR_UNSUPPORTED, "Текст обрабатывается только целиком");
+    }
+    return guardPluginCall(written, [&] {
+        return decryptVigenereInto(reinterpret_cast<const char*>(data), length, pluginKey(key, keyLength),
+                                   reinterpret_cast<char*>(out), outCapacity, true);
+    });
+}
+
+static void pluginSetMetricsEnabled(int enabled) {
+    callMetrics.setEnabled(enabled != 0);
+}
+
+static size_t pluginOutputSize(size_t length, const uint8_t* key, size_t keyLength, int decrypt, int binary) {
+    (void)key;
+    (void)keyLength;
+    (void)decrypt;
+    (void)binary;
+    return length;
+}
+
+const CipherPluginDescriptor* vigenerePluginDescriptor() {
+    static const CipherPluginDescriptor descriptor = {
+        CIPHER_PLUGIN_ABI_VERSION,
+        sizeof(CipherPluginDescriptor),
+        "vigenere",
+        CIPHER_CAP_STREAMING | CIPHER_CAP_IN_PLACE_BINARY | CIPHER_CAP_IN_PLACE_TEXT | CIPHER_CAP_PARALLEL_SAFE,
+        pluginSimdLevel(),
+        CIPHER_SIZE_SAME,
+        pluginOutputSize,
+        pluginEncryptBinary,
+        pluginDecryptBinary,
+        pluginEncryptText,
+        pluginDecryptText,
+        setVigenereParallelism,
+        pluginLastError,
+        vigenereKeyCacheStats,
+        pluginSetMetricsEnabled,
+        vigenereMetrics
+    };
+    return &descriptor;
+}
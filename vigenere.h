@@ -2,6 +2,7 @@
 #define CIPHER_VIGENERE_H
 
 #include <string>
+#include "cipher_plugin.h"
 using namespace std;
 
 #ifdef __cplusplus
@@ -20,6 +21,81 @@ string encryptVigenereBinary(const string& data, const string& key);
 
 __attribute__((visibility("default")))
 string decryptVigenereBinary(const string& data, const string& key);
+
+//бинарные функции с начальной позицией в потоке (для обработки по частям)
+__attribute__((visibility("default")))
+string encryptVigenereBinaryAt(const string& data, const string& key, size_t offset);
+
+__attribute__((visibility("default")))
+string decryptVigenereBinaryAt(const string& data, const string& key, size_t offset);
+
+//варианты с буфером вызывающего: результат пишется в out ёмкостью outCapacity,
+//возвращается число записанных байт (length_error, если буфер мал)
+__attribute__((visibility("default")))
+size_t encryptVigenereInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity, bool useCyrillic = true);
+
+__attribute__((visibility("default")))
+size_t decryptVigenereInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity, bool useCyrillic = true);
+
+__attribute__((visibility("default")))
+size_t encryptVigenereBinaryInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity);
+
+__attribute__((visibility("default")))
+size_t decryptVigenereBinaryInto(const char* data, size_t length, const string& key, char* out, size_t outCapacity);
+
+//преобразование на месте: шифр сохраняет длину, поэтому результат пишется
+//поверх data без второго буфера. offset - позиция data в бинарном потоке
+__attribute__((visibility("default")))
+void encryptVigenereInPlace(char* data, size_t length, const string& key, bool useCyrillic = true);
+
+__attribute__((visibility("default")))
+void decryptVigenereInPlace(char* data, size_t length, const string& key, bool useCyrillic = true);
+
+__attribute__((visibility("default")))
+void encryptVigenereBinaryInPlace(char* data, size_t length, const string& key, size_t offset = 0);
+
+__attribute__((visibility("default")))
+void decryptVigenereBinaryInPlace(char* data, size_t length, const string& key, size_t offset = 0);
+
+//размер выходного буфера, достаточный для результата в данном режиме
+__attribute__((visibility("default")))
+size_t vigenereOutputSize(size_t inputLength, const string& key, bool decrypt, bool binary);
+
+//параллельная обработка бинарных данных: threads потоков (0 - по числу ядер),
+//данные меньше minBytes на поток обрабатываются в одном потоке
+__attribute__((visibility("default")))
+void setVigenereParallelism(unsigned threads, size_t minBytes);
+
+//счётчики кэша скомпилированных ключей: повторные вызовы с тем же ключом
+//не разбирают его заново
+__attribute__((visibility("default")))
+void vigenereKeyCacheStats(CipherKeyCacheStats* stats);
+
+//счётчики вызовов: число, объём данных, время и гистограмма задержек по
+//операциям. Сбор по умолчанию выключен
+__attribute__((visibility("default")))
+void setVigenereMetricsEnabled(bool enabled);
+
+__attribute__((visibility("default")))
+void vigenereMetrics(CipherMetrics* metrics);
+
+//пошаговая обработка: ключ разбирается один раз в init, позиция ключа
+//сохраняется между вызовами update, final выдаёт остаток и освобождает контекст
+struct VigenereContext;
+
+__attribute__((visibility("default")))
+VigenereContext* vigenereInit(const string& key, bool decrypt, bool binary, bool useCyrillic = true);
+
+__attribute__((visibility("default")))
+string vigenereUpdate(VigenereContext* ctx, const string& data);
+
+__attribute__((visibility("default")))
+string vigenereFinal(VigenereContext* ctx);
+
+//описание библиотеки для двоичного интерфейса плагинов (cipher_plugin.h)
+__attribute__((visibility("default")))
+const CipherPluginDescriptor* vigenerePluginDescriptor();
+
 #ifdef __cplusplus
 }
 #endif